@@ -0,0 +1,45 @@
+#  Turns every file in SHADER_DIR into a constexpr char array and writes a table
+#  of them to OUTPUT, so shaders are part of the executable (see src/embeddedShaders.hpp)
+#
+#  cmake -DSHADER_DIR=src/shaders -DOUTPUT=embeddedShaderTable.hpp -P cmake/embedShaders.cmake
+
+if(NOT SHADER_DIR OR NOT OUTPUT)
+    message(FATAL_ERROR "embedShaders.cmake needs SHADER_DIR and OUTPUT")
+endif()
+
+file(GLOB shaderFiles RELATIVE ${SHADER_DIR} ${SHADER_DIR}/*)
+list(SORT shaderFiles)
+
+set(arrays "")
+set(entries "")
+set(index 0)
+
+foreach(shaderFile ${shaderFiles})
+
+    file(READ ${SHADER_DIR}/${shaderFile} hex HEX)
+    #  as '\xNN' character literals: 0xNN is an int, and anything above 0x7f
+    #  would be a narrowing conversion where char is signed
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])" "'\\\\x\\1'," bytes "${hex}")
+
+    #  16 bytes per line (cmake regexes have no {n} repetition)
+    string(REPEAT "'\\\\x..'," 16 line)
+    string(REGEX REPLACE "(${line})" "\\1\n    " bytes "${bytes}")
+
+    string(APPEND arrays "inline constexpr char embeddedShader${index}[] = {\n    ${bytes}'\\0'\n};\n\n")
+    string(APPEND entries "    {\"shaders/${shaderFile}\", embeddedShader${index}, sizeof(embeddedShader${index}) - 1},\n")
+
+    math(EXPR index "${index} + 1")
+endforeach()
+
+set(content "//  Generated by cmake/embedShaders.cmake from src/shaders, do not edit\n\n")
+string(APPEND content "${arrays}")
+string(APPEND content "inline constexpr EmbeddedShader embeddedShaderTable[] = {\n${entries}};\n")
+
+#  only touch the file when it changes, so unrelated builds do not recompile main.cpp
+if(EXISTS ${OUTPUT})
+    file(READ ${OUTPUT} previous)
+endif()
+
+if(NOT "${previous}" STREQUAL "${content}")
+    file(WRITE ${OUTPUT} "${content}")
+endif()
@@ -0,0 +1,989 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "pipeline.hpp"
+#include "shader.hpp"
+#include "commandBuffer.hpp"
+#include "renderQueue.hpp"
+#include "geometryPool.hpp"
+#include "bufferAllocator.hpp"
+#include "objLoader.hpp"
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//  Micro benchmarks run in place of the render loop (`--bench <name>`).
+//  They need a current context with glad loaded, ideally a headless one so
+//  the numbers are not capped by vsync
+class Benchmark {
+
+public:
+
+    //  frames rendered for every measurement, after a couple of warm-up frames
+    unsigned int frames = 20;
+
+    //  OBJ file for the `obj` benchmark, a generated model of `objMegabytes` when empty
+    std::string meshPath;
+    size_t objMegabytes = 256;
+
+    void run(const std::string& name) {
+
+        if (name == "instancing") {
+            instancing();
+        } else if (name == "streaming") {
+            streaming();
+        } else if (name == "shaders") {
+            shaders();
+        } else if (name == "uniforms") {
+            uniforms();
+        } else if (name == "commands") {
+            commands();
+        } else if (name == "sorting") {
+            sorting();
+        } else if (name == "pool") {
+            pool();
+        } else if (name == "allocator") {
+            allocator();
+        } else if (name == "obj") {
+            obj();
+        } else {
+            throw std::runtime_error("Unknown benchmark: " + name);
+        }
+
+    }
+
+    //  One draw call and two uniform updates per object against a single
+    //  glDrawArraysInstanced reading the same data from the instance VBO
+    void instancing() {
+
+        Shader objectShader(embeddedShader("shaders/object.vs"), embeddedShader("shaders/shader.fs"));
+        Shader instancedShader(embeddedShader("shaders/instanced.vs"), embeddedShader("shaders/shader.fs"));
+        objectShader.processShaders();
+        instancedShader.processShaders();
+
+        UniformHandle transformUniform = objectShader.uniform("transform");
+        UniformHandle colorUniform = objectShader.uniform("objectColor");
+
+        std::printf("%10s %16s %16s %10s\n", "instances", "per-object ms", "instanced ms", "speedup");
+
+        const uint32_t counts[] = {1000, 10000, 100000};
+
+        for (uint32_t count : counts) {
+
+            std::vector<float> instances = makeInstances(count);
+
+            GraphicsPipeline pipeline;
+            pipeline.generateVAO();
+            pipeline.handleVBO();
+            pipeline.setVertexAttribute();
+            pipeline.handleInstanceVBO(instances);
+            pipeline.setInstanceAttribute();
+
+            double perObject = timeFrames([&]() {
+                objectShader.useProgram();
+                pipeline.bindVAO();
+
+                for (uint32_t i = 0; i < count; i++) {
+                    const float* instance = &instances[i * GraphicsPipeline::instanceStride];
+                    objectShader.setVec4(transformUniform, instance);
+                    objectShader.setVec3(colorUniform, instance + 4);
+                    pipeline.drawTriangle(3);
+                }
+            });
+
+            double instanced = timeFrames([&]() {
+                instancedShader.useProgram();
+                pipeline.bindVAO();
+                pipeline.drawInstanced(count);
+            });
+
+            std::printf("%10u %16.3f %16.3f %9.1fx\n", count, perObject, instanced, perObject / instanced);
+
+            pipeline.destroy();
+        }
+
+        objectShader.destroy();
+        instancedShader.destroy();
+    }
+
+    //  Upload throughput of dynamic vertices: the fenced, unsynchronized
+    //  StreamBuffer against rewriting one VBO with glBufferSubData every frame
+    void streaming() {
+
+        Shader shader(embeddedShader("shaders/shader.vs"), embeddedShader("shaders/shader.fs"));
+        shader.processShaders();
+
+        const int vertexSize = 6 * sizeof(float);
+
+        std::printf("%10s %18s %18s %10s\n", "MB/frame", "subdata MB/s", "stream MB/s", "stalls");
+
+        const int megabytes[] = {1, 4, 16};
+
+        for (int mb : megabytes) {
+
+            //  whole triangles only
+            GLsizeiptr numVertices = (mb * 1024 * 1024 / vertexSize) / 3 * 3;
+            GLsizeiptr bytes = numVertices * vertexSize;
+
+            //  degenerate triangles, so rasterization does not hide the upload cost
+            std::vector<float> source(numVertices * 6, 0.0f);
+
+            GraphicsPipeline subData;
+            subData.generateVAO();
+            subData.bindVAO();
+            subData.VBO = GLResources::createBuffer();
+            glBindBuffer(GL_ARRAY_BUFFER, GLResources::get(subData.VBO));
+            glBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+            subData.setVertexAttribute();
+
+            double subDataMs = timeFrames([&]() {
+                shader.useProgram();
+                subData.bindVAO();
+                glBindBuffer(GL_ARRAY_BUFFER, GLResources::get(subData.VBO));
+                glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, &source[0]);
+                subData.drawTriangle(numVertices);
+            }, false);
+
+            GraphicsPipeline streamed;
+            StreamBuffer stream;
+            streamed.generateVAO();
+            streamed.handleStreamVBO(stream, bytes);
+            streamed.setVertexAttribute();
+
+            double streamMs = timeFrames([&]() {
+                void* data = stream.map(bytes);
+                std::memcpy(data, &source[0], bytes);
+                stream.unmap();
+
+                shader.useProgram();
+                streamed.bindVAO();
+                streamed.drawTriangle(numVertices, stream.offset() / vertexSize);
+                stream.endFrame();
+            }, false);
+
+            double megabytesPerFrame = bytes / (1024.0 * 1024.0);
+            std::printf("%10.1f %18.1f %18.1f %10lu\n", megabytesPerFrame,
+                megabytesPerFrame * 1000.0 / subDataMs, megabytesPerFrame * 1000.0 / streamMs, stream.stalls);
+
+            stream.destroy();
+            subData.destroy();
+            streamed.destroy();
+        }
+
+        shader.destroy();
+    }
+
+    //  Per-object data through two glUniform calls per draw against std140 blocks
+    //  packed into one uniform buffer, uploaded once per frame and selected per
+    //  draw with glBindBufferRange
+    void uniforms() {
+
+        Shader objectShader(embeddedShader("shaders/object.vs"), embeddedShader("shaders/shader.fs"));
+        Shader blockShader(embeddedShader("shaders/objectBlock.vs"), embeddedShader("shaders/shader.fs"));
+        objectShader.processShaders();
+        blockShader.processShaders();
+
+        UniformHandle transformUniform = objectShader.uniform("transform");
+        UniformHandle colorUniform = objectShader.uniform("objectColor");
+
+        std::printf("%10s %16s %16s %10s\n", "objects", "glUniform ms", "UBO range ms", "speedup");
+
+        const uint32_t counts[] = {1000, 10000, 100000};
+
+        for (uint32_t count : counts) {
+
+            std::vector<float> instances = makeInstances(count);
+
+            GraphicsPipeline pipeline;
+            pipeline.generateVAO();
+            pipeline.handleVBO();
+            pipeline.setVertexAttribute();
+
+            UniformBuffer uniformBuffer;
+            uniformBuffer.create(count * ((ObjectLayout::size + 255) / 256 * 256));
+
+            std::vector<size_t> blocks(count);
+            for (uint32_t i = 0; i < count; i++) blocks[i] = uniformBuffer.allocate(ObjectLayout::size);
+
+            double perUniform = timeFrames([&]() {
+                objectShader.useProgram();
+                pipeline.bindVAO();
+
+                for (uint32_t i = 0; i < count; i++) {
+                    const float* instance = &instances[i * GraphicsPipeline::instanceStride];
+                    objectShader.setVec4(transformUniform, instance);
+                    objectShader.setVec3(colorUniform, instance + 4);
+                    pipeline.drawTriangle(3);
+                }
+            });
+
+            double perRange = timeFrames([&]() {
+
+                //  the data is re-sent every frame, as it would be for moving objects
+                for (uint32_t i = 0; i < count; i++) {
+                    const float* instance = &instances[i * GraphicsPipeline::instanceStride];
+                    Std140Block<ObjectLayout> object;
+                    object.set<ObjectTransform>(Vec4{{instance[0], instance[1], instance[2], instance[3]}});
+                    object.set<ObjectColor>(Vec3{{instance[4], instance[5], instance[6]}});
+                    uniformBuffer.write(blocks[i], object.data, sizeof(object.data));
+                }
+
+                uniformBuffer.upload();
+
+                blockShader.useProgram();
+                pipeline.bindVAO();
+
+                for (uint32_t i = 0; i < count; i++) {
+                    uniformBuffer.bindRange(ObjectBinding, blocks[i], ObjectLayout::size);
+                    pipeline.drawTriangle(3);
+                }
+            });
+
+            std::printf("%10u %16.3f %16.3f %9.1fx\n", count, perUniform, perRange, perUniform / perRange);
+
+            uniformBuffer.destroy();
+            pipeline.destroy();
+        }
+
+        objectShader.destroy();
+        blockShader.destroy();
+    }
+
+    //  Per-object work (here animating each transform) done inline with the GL
+    //  calls on one thread, against recording the same calls into command buffers
+    //  on every core and replaying them on the GL thread
+    void commands() {
+
+        Shader objectShader(embeddedShader("shaders/object.vs"), embeddedShader("shaders/shader.fs"));
+        objectShader.processShaders();
+
+        UniformHandle transformUniform = objectShader.uniform("transform");
+        UniformHandle colorUniform = objectShader.uniform("objectColor");
+
+        CommandRecorder recorder;
+
+        //  objects per job, enough to amortize claiming one
+        const uint32_t objectsPerJob = 256;
+
+        std::printf("recording on %u threads\n", recorder.threadCount());
+        std::printf("%10s %14s %14s %14s %14s %10s\n", "objects", "direct ms", "record ms", "replay ms", "recorded ms", "KB");
+
+        const uint32_t counts[] = {1000, 10000, 100000};
+
+        for (uint32_t count : counts) {
+
+            std::vector<float> instances = makeInstances(count);
+
+            GraphicsPipeline pipeline;
+            pipeline.generateVAO();
+            pipeline.handleVBO();
+            pipeline.setVertexAttribute();
+
+            float time = 0.0f;
+
+            double direct = timeFrames([&]() {
+                objectShader.useProgram();
+                pipeline.bindVAO();
+
+                for (uint32_t i = 0; i < count; i++) {
+                    float transform[4];
+                    animate(&instances[i * GraphicsPipeline::instanceStride], time, transform);
+                    objectShader.setVec4(transformUniform, transform);
+                    objectShader.setVec3(colorUniform, &instances[i * GraphicsPipeline::instanceStride + 4]);
+                    pipeline.drawTriangle(3);
+                }
+
+                time += 0.01f;
+            });
+
+            size_t numJobs = (count + objectsPerJob - 1) / objectsPerJob;
+            double recordMs = 0.0;
+            double replayMs = 0.0;
+
+            double recorded = timeFrames([&]() {
+
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+                recorder.record(numJobs, [&](size_t job, CommandBuffer& buffer) {
+
+                    buffer.bindProgram(objectShader.shaderProgram());
+                    buffer.bindVertexArray(GLResources::get(pipeline.VAO));
+
+                    uint32_t end = std::min<uint32_t>(count, (uint32_t)(job + 1) * objectsPerJob);
+
+                    for (uint32_t i = (uint32_t)job * objectsPerJob; i < end; i++) {
+                        float transform[4];
+                        animate(&instances[i * GraphicsPipeline::instanceStride], time, transform);
+                        buffer.uniform4fv(transformUniform.location, transform);
+                        buffer.uniform3fv(colorUniform.location, &instances[i * GraphicsPipeline::instanceStride + 4]);
+                        buffer.drawArrays(GL_TRIANGLES, 0, 3);
+                    }
+                });
+
+                std::chrono::steady_clock::time_point recordEnd = std::chrono::steady_clock::now();
+
+                recorder.replay();
+
+                recordMs += std::chrono::duration<double, std::milli>(recordEnd - start).count();
+                replayMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - recordEnd).count();
+                time += 0.01f;
+            });
+
+            //  two warm-up frames are timed too
+            std::printf("%10u %14.3f %14.3f %14.3f %14.3f %10.1f\n", count, direct,
+                recordMs / (frames + 2), replayMs / (frames + 2), recorded, recorder.bytes() / 1024.0);
+
+            pipeline.destroy();
+        }
+
+        objectShader.destroy();
+    }
+
+    //  Draws spread at random over programs, VAOs and textures, issued in the order
+    //  they were added against sorted by RenderQueue. Reports the cost of the radix
+    //  sort (std::sort of the same keys for scale), the binds each order needs and
+    //  the resulting frame times
+    void sorting() {
+
+        const int numPrograms = 8;
+        const int numVAOs = 16;
+        const int numTextures = 4;
+
+        std::vector<Shader> programs;
+        programs.reserve(numPrograms);
+
+        for (int i = 0; i < numPrograms; i++) {
+            char tag[32];
+            std::snprintf(tag, sizeof(tag), "// sort variant %d\n", i);
+            programs.push_back(Shader::fromSource(withTag(embeddedShader("shaders/shader.vs").source, tag),
+                withTag(embeddedShader("shaders/shader.fs").source, tag)));
+            programs.back().processShaders();
+        }
+
+        std::vector<GraphicsPipeline> pipelines(numVAOs);
+
+        for (GraphicsPipeline& pipeline : pipelines) {
+            pipeline.generateVAO();
+            pipeline.handleVBO();
+            pipeline.setVertexAttribute();
+        }
+
+        GLuint textures[numTextures];
+        glGenTextures(numTextures, textures);
+
+        for (int i = 0; i < numTextures; i++) {
+            const unsigned char texel[4] = {(unsigned char)(i * 60), 128, 255, 255};
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+        }
+
+        //  every draw covers most of the target; shrink it so the timings show
+        //  submission rather than fill rate
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glViewport(0, 0, 8, 8);
+
+        std::printf("%8s %10s %10s %12s %18s %18s %12s %12s\n", "draws", "radix ms", "std ms",
+            "add ms", "binds unsorted", "binds sorted", "unsorted ms", "sorted ms");
+
+        const uint32_t counts[] = {1000, 10000, 100000};
+
+        for (uint32_t count : counts) {
+
+            //  fixed seed, every run sees the same scene
+            uint32_t seed = 12345;
+            auto next = [&seed]() { seed = seed * 1664525u + 1013904223u; return seed >> 8; };
+
+            std::vector<RenderQueue::Draw> scene(count);
+            std::vector<float> depths(count);
+
+            for (uint32_t i = 0; i < count; i++) {
+                RenderQueue::Draw& draw = scene[i];
+                draw.program = programs[next() % numPrograms].shaderProgram();
+                draw.vao = GLResources::get(pipelines[next() % numVAOs].VAO);
+                draw.texture = textures[next() % numTextures];
+                draw.count = 3;
+                draw.object = i;
+                depths[i] = (next() & 0xFFFF) / 65535.0f;
+            }
+
+            RenderQueue queue;
+            queue.reserve(count);
+
+            double addMs = 0.0, radixMs = 0.0, stdMs = 0.0;
+            const int sorts = 10;
+
+            for (int i = 0; i < sorts; i++) {
+
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                queue.clear();
+                for (uint32_t j = 0; j < count; j++) queue.add(scene[j], depths[j]);
+                std::chrono::steady_clock::time_point added = std::chrono::steady_clock::now();
+                queue.sort();
+                std::chrono::steady_clock::time_point sorted = std::chrono::steady_clock::now();
+
+                addMs += std::chrono::duration<double, std::milli>(added - start).count();
+                radixMs += std::chrono::duration<double, std::milli>(sorted - added).count();
+
+                std::vector<uint64_t> keys(count);
+                for (uint32_t j = 0; j < count; j++) {
+                    keys[j] = RenderQueue::makeKey(0, scene[j].program, scene[j].vao, scene[j].texture, depths[j]);
+                }
+
+                start = std::chrono::steady_clock::now();
+                std::sort(keys.begin(), keys.end());
+                stdMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+                for (uint32_t j = 0; j < count; j++) {
+                    if (queue.key(j) != keys[j]) throw std::runtime_error("RenderQueue: radix sort disagrees with std::sort");
+                }
+            }
+
+            //  issue order as added
+            RenderQueue unsorted;
+            unsorted.reserve(count);
+            for (uint32_t j = 0; j < count; j++) unsorted.add(scene[j], depths[j]);
+
+            double unsortedMs = timeFrames([&]() { unsorted.submit(); });
+            double sortedMs = timeFrames([&]() { queue.submit(); });
+
+            const RenderQueue::Stats& before = unsorted.stats;
+            const RenderQueue::Stats& after = queue.stats;
+
+            std::printf("%8u %10.3f %10.3f %12.3f %18lu %18lu %12.3f %12.3f\n", count, radixMs / sorts, stdMs / sorts, addMs / sorts,
+                before.programChanges + before.vaoChanges + before.textureChanges,
+                after.programChanges + after.vaoChanges + after.textureChanges, unsortedMs, sortedMs);
+
+            std::printf("%8s program/VAO/texture binds: unsorted %lu/%lu/%lu, sorted %lu/%lu/%lu\n", "",
+                before.programChanges, before.vaoChanges, before.textureChanges,
+                after.programChanges, after.vaoChanges, after.textureChanges);
+        }
+
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        glDeleteTextures(numTextures, textures);
+
+        for (GraphicsPipeline& pipeline : pipelines) pipeline.destroy();
+
+        for (Shader& program : programs) program.destroy();
+    }
+
+    //  Many small meshes, each in its own VAO/VBO/EBO and drawn with a bind and a
+    //  glDrawElements of its own, against all of them in one GeometryPool drawn
+    //  with a single glMultiDrawElementsBaseVertex
+    void pool() {
+
+        Shader shader(embeddedShader("shaders/shader.vs"), embeddedShader("shaders/shader.fs"));
+        shader.processShaders();
+
+        std::printf("%10s %16s %16s %10s %12s\n", "meshes", "per-mesh ms", "pool ms", "speedup", "pool KB");
+
+        const uint32_t counts[] = {1000, 10000, 100000};
+
+        for (uint32_t count : counts) {
+
+            std::vector<Mesh> meshes;
+            meshes.reserve(count);
+            for (uint32_t i = 0; i < count; i++) meshes.push_back(makeQuad(i, count));
+
+            std::vector<GraphicsPipeline> separate(count);
+
+            for (uint32_t i = 0; i < count; i++) {
+                separate[i].loadMesh(Mesh(meshes[i]));
+                separate[i].generateVAO();
+                separate[i].handleVBO();
+                separate[i].handleEBO();
+                separate[i].setVertexAttribute();
+            }
+
+            GeometryPool geometry;
+            geometry.create(count * 4, count * 6);
+
+            GeometryPool::Batch batch;
+            for (const Mesh& mesh : meshes) batch.add(geometry.add(mesh));
+
+            double perMesh = timeFrames([&]() {
+                shader.useProgram();
+                for (GraphicsPipeline& pipeline : separate) {
+                    pipeline.bindVAO();
+                    pipeline.draw();
+                }
+            });
+
+            double pooled = timeFrames([&]() {
+                shader.useProgram();
+                geometry.draw(batch);
+            });
+
+            std::printf("%10u %16.3f %16.3f %9.1fx %12.1f\n", count, perMesh, pooled, perMesh / pooled,
+                count * (4 * GeometryPool::Layout::stride + 6 * sizeof(uint32_t)) / 1024.0);
+
+            geometry.destroy();
+
+            for (GraphicsPipeline& pipeline : separate) pipeline.destroy();
+        }
+
+        shader.destroy();
+    }
+
+    //  Creating, filling and deleting a GL buffer per mesh against ranges of one
+    //  buffer from BufferAllocator, then a long run of random frees and allocations
+    //  to see how fragmented the allocator gets and what defragmenting it costs.
+    //  Every range is filled with its own byte pattern and read back after
+    //  defragmenting, so moved data is checked as well
+    void allocator() {
+
+        const size_t capacity = 128 << 20;
+        const uint32_t count = 10000;
+
+        uint32_t seed = 777;
+        auto next = [&seed]() { seed = seed * 1664525u + 1013904223u; return seed >> 8; };
+
+        //  mesh sized requests, 256 bytes to 16 KB
+        const size_t maxSize = 16 << 10;
+        auto randomSize = [&next, maxSize]() { return 256 + next() % (maxSize - 256); };
+
+        std::vector<size_t> sizes(count);
+        for (size_t& size : sizes) size = randomSize();
+
+        std::vector<unsigned char> data(maxSize, 0xAB);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        std::vector<GLuint> buffers(count);
+        glGenBuffers(count, buffers.data());
+        for (uint32_t i = 0; i < count; i++) {
+            glBindBuffer(GL_ARRAY_BUFFER, buffers[i]);
+            glBufferData(GL_ARRAY_BUFFER, sizes[i], data.data(), GL_STATIC_DRAW);
+        }
+        glDeleteBuffers(count, buffers.data());
+        glFinish();
+
+        double separateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        BufferAllocator allocator;
+        allocator.create(capacity);
+
+        start = std::chrono::steady_clock::now();
+
+        std::vector<BufferAllocator::Allocation> allocations(count);
+        for (uint32_t i = 0; i < count; i++) {
+            allocations[i] = allocator.allocate(sizes[i], 256);
+            if (!allocations[i].valid()) throw std::runtime_error("BufferAllocator: out of space");
+            allocator.upload(allocations[i], data.data(), sizes[i]);
+        }
+        for (BufferAllocator::Allocation& allocation : allocations) allocator.free(allocation);
+        allocator.endFrame();
+        glFinish();
+
+        double subAllocatedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::printf("%u meshes: buffer each %.3f ms, sub-allocated %.3f ms (%.1fx)\n",
+            count, separateMs, subAllocatedMs, separateMs / subAllocatedMs);
+
+        //  let the GPU catch up so the frees above are released
+        allocator.endFrame();
+
+        //  churn: keep `count` ranges alive, replace a random one per step
+        std::vector<unsigned char> patterns(count);
+        for (uint32_t i = 0; i < count; i++) {
+            allocations[i] = allocator.allocate(sizes[i], 256);
+            patterns[i] = (unsigned char)i;
+            fill(allocator, allocations[i], patterns[i], sizes[i], data);
+        }
+
+        const uint32_t steps = 200000;
+        double allocatorMs = 0.0;
+
+        for (uint32_t step = 0; step < steps; step++) {
+
+            uint32_t i = next() % count;
+            sizes[i] = randomSize();
+
+            std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+            allocator.free(allocations[i]);
+            allocations[i] = allocator.allocate(sizes[i], 256);
+            allocatorMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+            if (!allocations[i].valid()) {
+                throw std::runtime_error("BufferAllocator: out of space during churn");
+            }
+
+            patterns[i] = (unsigned char)(step * 31 + i);
+            fill(allocator, allocations[i], patterns[i], sizes[i], data);
+
+            //  a frame every 100 replacements
+            if (step % 100 == 99) allocator.endFrame();
+        }
+
+        glFinish();
+        allocator.endFrame();
+
+        std::printf("%u free + allocate pairs: %.1f ns per pair\n", steps, allocatorMs * 1e6 / steps);
+        std::printf("before defragmenting: ");
+        allocator.report();
+
+        start = std::chrono::steady_clock::now();
+        unsigned int passes = 0;
+
+        //  1 MB per call, as a frame would
+        while (allocator.defragment(1 << 20) > 0) passes++;
+        glFinish();
+
+        double defragmentMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::printf("defragmented in %u steps of 1 MB, %.3f ms\n", passes, defragmentMs);
+        std::printf("after defragmenting: ");
+        allocator.report();
+
+        //  every range still holds its pattern at its new offset
+        std::vector<unsigned char> contents(capacity);
+        glBindBuffer(GL_COPY_READ_BUFFER, GLResources::get(allocator.buffer));
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, capacity, contents.data());
+
+        for (uint32_t i = 0; i < count; i++) {
+            size_t offset = allocator.offset(allocations[i]);
+            if (offset % 256 != 0) {
+                throw std::runtime_error("BufferAllocator: alignment lost while defragmenting");
+            }
+            for (size_t b = 0; b < sizes[i]; b++) {
+                if (contents[offset + b] != patterns[i]) {
+                    throw std::runtime_error("BufferAllocator: data lost while defragmenting");
+                }
+            }
+        }
+
+        std::printf("contents verified\n");
+
+        allocator.destroy();
+    }
+
+    //  Float parsing on its own, ObjLoader::parseFloat against strtof, then loading a
+    //  multi-hundred MB OBJ file with 1, 2, 4 and one thread per core. Every load
+    //  has to produce exactly the mesh of the single threaded one. The mesh is
+    //  then uploaded through GraphicsPipeline to show it is ready to draw
+    void obj() {
+
+        floatParsing();
+
+        std::string path = meshPath;
+        bool generated = path.empty();
+
+        if (generated) {
+            path = (std::filesystem::temp_directory_path() / "benchmark_sphere.obj").string();
+            writeSphere(path, objMegabytes);
+        }
+
+        std::vector<unsigned int> threadCounts = {1, 2, 4, ObjLoader::defaultThreads()};
+        std::sort(threadCounts.begin(), threadCounts.end());
+        threadCounts.erase(std::unique(threadCounts.begin(), threadCounts.end()), threadCounts.end());
+
+        std::printf("%10s %12s %10s %12s %12s %12s\n", "threads", "load ms", "MB/s", "parse ms", "merge ms", "index ms");
+
+        Mesh reference;
+
+        for (unsigned int threads : threadCounts) {
+
+            ObjLoader loader;
+            loader.threads = threads;
+            Mesh mesh = loader.load(path);
+
+            const ObjLoader::Timings& timings = loader.timings;
+            std::printf("%10u %12.1f %10.0f %12.1f %12.1f %12.1f\n", threads, timings.total(),
+                loader.bytes / (1024.0 * 1024.0) * 1000.0 / timings.total(), timings.parse, timings.merge, timings.index);
+
+            if (threads == threadCounts.front()) {
+                loader.report(std::filesystem::path(path).filename().string());
+                reference = std::move(mesh);
+            } else if (mesh.vertices != reference.vertices || mesh.indices != reference.indices) {
+                throw std::runtime_error("ObjLoader: result depends on the thread count");
+            }
+        }
+
+        size_t vertexCount = reference.vertexCount();
+        size_t indexCount = reference.indices.size();
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        GraphicsPipeline pipeline;
+        pipeline.loadMesh(std::move(reference));
+        pipeline.generateVAO();
+        pipeline.handleVBO();
+        pipeline.handleEBO();
+        pipeline.setVertexAttribute();
+        glFinish();
+
+        double uploadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::printf("upload: %zu vertices, %zu indices in %.1f ms\n", vertexCount, indexCount, uploadMs);
+
+        pipeline.destroy();
+
+        if (generated) std::filesystem::remove(path);
+    }
+
+    //  Startup cost of building many programs: compiling and linking each one
+    //  before submitting the next against submitting all of them and then waiting.
+    //  Every program gets a unique comment so no driver-side cache can answer it
+    void shaders() {
+
+        const int numPrograms = 32;
+
+        Shader::enableParallelCompile();
+
+        std::printf("%10s %16s %16s %10s\n", "programs", "serial ms", "async ms", "speedup");
+
+        double serial = buildPrograms(numPrograms, false);
+        double async = buildPrograms(numPrograms, true);
+
+        std::printf("%10d %16.3f %16.3f %9.1fx\n", numPrograms, serial, async, serial / async);
+    }
+
+private:
+
+    //  Wall time in milliseconds to get `count` programs ready for use
+    double buildPrograms(int count, bool async) {
+
+        static unsigned long long nonce = std::chrono::steady_clock::now().time_since_epoch().count();
+
+        std::vector<Shader> programs;
+        programs.reserve(count);
+
+        for (int i = 0; i < count; i++) {
+
+            char tag[64];
+            std::snprintf(tag, sizeof(tag), "// variant %llx\n", nonce++);
+
+            programs.push_back(Shader::fromSource(withTag(embeddedShader("shaders/shader.vs").source, tag),
+                withTag(embeddedShader("shaders/shader.fs").source, tag)));
+            programs.back().useProgramCache = false;
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        if (async) {
+            for (Shader& program : programs) program.submitShaders();
+            for (Shader& program : programs) program.finishShaders();
+        } else {
+            for (Shader& program : programs) program.processShaders();
+        }
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+        for (Shader& program : programs) program.destroy();
+
+        return elapsed.count();
+    }
+
+    //  Insert `tag` after the #version line, which has to stay first
+    static std::string withTag(const char* source, const char* tag) {
+
+        std::string code = source;
+        size_t line = code.find('\n');
+        code.insert(line == std::string::npos ? code.size() : line + 1, tag);
+        return code;
+    }
+
+    //  Average wall time of a frame in milliseconds. By default it waits for
+    //  the GPU at the end of every frame so queued work is not left out;
+    //  pipelined code passes `finishEachFrame = false` and is only waited for at the end
+    double timeFrames(const std::function<void()>& drawFrame, bool finishEachFrame = true) {
+
+        for (int i = 0; i < 2; i++) {
+            glClear(GL_COLOR_BUFFER_BIT);
+            drawFrame();
+            glFinish();
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        for (unsigned int i = 0; i < frames; i++) {
+            glClear(GL_COLOR_BUFFER_BIT);
+            drawFrame();
+            if (finishEachFrame) glFinish();
+        }
+
+        glFinish();
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() / frames;
+    }
+
+    //  Stand-in for per-object scene work: spin the object around its cell and pulse its scale
+    static void animate(const float* instance, float time, float* transform) {
+
+        float phase = time + instance[0] * 3.0f + instance[1] * 5.0f;
+        float radius = instance[3] * 0.25f;
+
+        transform[0] = instance[0] + radius * std::cos(phase);
+        transform[1] = instance[1] + radius * std::sin(phase);
+        transform[2] = instance[2];
+        transform[3] = instance[3] * (0.75f + 0.25f * std::sin(phase * 2.0f));
+    }
+
+    static void fill(BufferAllocator& allocator, BufferAllocator::Allocation allocation, unsigned char pattern,
+        size_t size, std::vector<unsigned char>& scratch) {
+
+        std::memset(scratch.data(), pattern, size);
+        allocator.upload(allocation, scratch.data(), size);
+    }
+
+    //  Numbers the way exporters write them, 6 decimals and %g with 9 digits
+    void floatParsing() {
+
+        const int count = 4000000;
+
+        uint32_t seed = 4242;
+        auto next = [&seed]() { seed = seed * 1664525u + 1013904223u; return seed >> 8; };
+
+        std::string text;
+        text.reserve(count * 16);
+
+        for (int i = 0; i < count; i++) {
+            char number[32];
+            double value = ((double)(next() % 2000001) / 1000000.0 - 1.0) * std::pow(10.0, (int)(next() % 7) - 3);
+            std::snprintf(number, sizeof(number), i % 2 ? "%.6f " : "%.9g ", value);
+            text += number;
+        }
+
+        const char* end = text.data() + text.size();
+        float fastSum = 0.0f, slowSum = 0.0f;
+        int mismatches = 0;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        for (const char* p = text.data(); p < end; p++) {
+            float value;
+            p = ObjLoader::parseFloat(p, end, value);
+            fastSum += value;
+        }
+
+        double fastMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        start = std::chrono::steady_clock::now();
+
+        for (const char* p = text.data(); p < end; p++) {
+            char* stop;
+            slowSum += std::strtof(p, &stop);
+            p = stop;
+        }
+
+        double slowMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        for (const char* p = text.data(); p < end; p++) {
+            float fast;
+            char* stop;
+            float slow = std::strtof(p, &stop);
+            p = ObjLoader::parseFloat(p, end, fast);
+            if (fast != slow) mismatches++;
+        }
+
+        std::printf("%10s %12s %12s %10s %12s\n", "floats", "strtof ms", "parse ms", "speedup", "mismatches");
+        std::printf("%10d %12.1f %12.1f %9.1fx %12d\n", count, slowMs, fastMs, slowMs / fastMs, mismatches);
+
+        //  keeps the sums, and with them the parsing, from being optimized away
+        if (fastSum != slowSum && mismatches == 0) std::printf("sums differ\n");
+    }
+
+    //  A UV sphere with normals, `v`, `vn` and `f v//vn` lines, fine enough to
+    //  take about `megabytes` of text
+    static void writeSphere(const std::string& path, size_t megabytes) {
+
+        //  one grid vertex costs about 160 bytes: a `v`, a `vn` and two faces
+        size_t side = std::max<size_t>(8, (size_t)std::sqrt(megabytes * 1024.0 * 1024.0 / 160.0));
+
+        FILE* file = std::fopen(path.c_str(), "w");
+        if (!file) {
+            throw std::runtime_error("Failed to create " + path);
+        }
+
+        std::vector<char> buffer(1 << 20);
+        std::setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+
+        const double pi = 3.14159265358979323846;
+
+        for (int pass = 0; pass < 2; pass++) {
+            for (size_t row = 0; row < side; row++) {
+
+                double theta = pi * row / (side - 1);
+
+                for (size_t column = 0; column < side; column++) {
+
+                    double phi = 2.0 * pi * column / side;
+                    double x = std::sin(theta) * std::cos(phi), y = std::cos(theta), z = std::sin(theta) * std::sin(phi);
+                    std::fprintf(file, pass == 0 ? "v %.6f %.6f %.6f\n" : "vn %.6f %.6f %.6f\n", x, y, z);
+                }
+            }
+        }
+
+        for (size_t row = 0; row + 1 < side; row++) {
+            for (size_t column = 0; column < side; column++) {
+
+                size_t a = row * side + column + 1;
+                size_t b = row * side + (column + 1) % side + 1;
+                size_t c = a + side, d = b + side;
+
+                std::fprintf(file, "f %zu//%zu %zu//%zu %zu//%zu\n", a, a, c, c, b, b);
+                std::fprintf(file, "f %zu//%zu %zu//%zu %zu//%zu\n", b, b, c, c, d, d);
+            }
+        }
+
+        std::fclose(file);
+    }
+
+    //  Quad `i` of `count` on the same grid as makeInstances, as its own indexed mesh
+    static Mesh makeQuad(uint32_t i, uint32_t count) {
+
+        uint32_t side = (uint32_t)std::ceil(std::sqrt((double)count));
+        float cell = 2.0f / side;
+        float u = (float)(i % side) / side;
+        float v = (float)(i / side) / side;
+        float x = -1.0f + u * 2.0f + cell * 0.1f;
+        float y = -1.0f + v * 2.0f + cell * 0.1f;
+        float size = cell * 0.8f;
+
+        const float corners[4][2] = {{x, y}, {x + size, y}, {x + size, y + size}, {x, y + size}};
+        const int triangles[6] = {0, 1, 2, 0, 2, 3};
+
+        std::vector<float> soup;
+        for (int corner : triangles) {
+            soup.insert(soup.end(), {corners[corner][0], corners[corner][1], 0.0f, u, v, 1.0f - u});
+        }
+
+        return buildIndexedMesh(soup, 6);
+    }
+
+    //  Lay the copies out on a square grid covering the viewport, each one
+    //  scaled down to its cell and tinted by its position
+    std::vector<float> makeInstances(uint32_t count) {
+
+        uint32_t side = (uint32_t)std::ceil(std::sqrt((double)count));
+        float cell = 2.0f / side;
+
+        std::vector<float> instances;
+        instances.reserve(count * GraphicsPipeline::instanceStride);
+
+        for (uint32_t i = 0; i < count; i++) {
+            float u = (float)(i % side) / side;
+            float v = (float)(i / side) / side;
+
+            instances.push_back(-1.0f + cell * 0.5f + u * 2.0f);    //  offset
+            instances.push_back(-1.0f + cell * 0.5f + v * 2.0f);
+            instances.push_back(0.0f);
+            instances.push_back(cell);                              //  scale
+
+            instances.push_back(u);                                 //  color
+            instances.push_back(v);
+            instances.push_back(1.0f - u);
+        }
+
+        return instances;
+    }
+
+};
+
+#endif
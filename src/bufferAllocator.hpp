@@ -0,0 +1,606 @@
+#ifndef BUFFER_ALLOCATOR_H
+#define BUFFER_ALLOCATOR_H
+
+#include "glad/glad.h"
+#include "glResources.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <stdexcept>
+#include <vector>
+
+//  Two-level segregated fit (TLSF) allocator over a range of offsets. It only
+//  does the bookkeeping, the memory itself is a GL buffer (see BufferAllocator).
+//  Free blocks sit in lists by size class: the first level is the power of two
+//  of the size, the second splits each power of two into 16 steps. A bitmap per
+//  level makes finding a large enough block two bit scans, so allocate and free
+//  take constant time however fragmented the range is. Neighbouring free blocks
+//  are merged on free, and every offset and size is a multiple of `granularity`.
+class TLSFAllocator {
+
+public:
+
+    typedef uint32_t Block;
+    static constexpr Block none = ~0u;
+
+    static constexpr size_t granularity = 16;
+
+    //  bytes handed out / in free blocks
+    size_t used = 0;
+    size_t capacity = 0;
+
+    void create(size_t _capacity) {
+
+        capacity = _capacity / granularity * granularity;
+        used = 0;
+
+        blocks.clear();
+        unusedNodes.clear();
+        flBitmap = 0;
+        std::fill(slBitmaps, slBitmaps + flCount, 0u);
+        std::fill(&heads[0][0], &heads[0][0] + flCount * slCount, none);
+
+        head = newNode();
+        blocks[head].offset = 0;
+        blocks[head].size = capacity;
+        insertFree(head);
+    }
+
+    //  `alignment` is a power of two. Returns `none` when no free block is large enough
+    Block allocate(size_t size, size_t alignment = granularity) {
+
+        size = roundUp(std::max<size_t>(size, 1), granularity);
+        alignment = std::max(alignment, granularity);
+
+        //  any block this large can hold an aligned range of `size`
+        size_t request = size + alignment - granularity;
+
+        Block block = findFree(request);
+        if (block == none) return none;
+
+        removeFree(block);
+
+        //  give back the bytes skipped to reach the alignment
+        size_t padding = roundUp(blocks[block].offset, alignment) - blocks[block].offset;
+
+        if (padding > 0) {
+            Block front = split(block, padding);
+            std::swap(block, front);
+            insertFree(front);
+        }
+
+        //  and what is left over at the end
+        if (blocks[block].size - size >= granularity) {
+            Block tail = split(block, size);
+            insertFree(tail);
+        }
+
+        blocks[block].state = Used;
+        blocks[block].alignment = alignment;
+        used += blocks[block].size;
+        return block;
+    }
+
+    void free(Block block) {
+
+        if (blocks[block].state == Free) {
+            throw std::runtime_error("TLSFAllocator: block freed twice");
+        }
+
+        used -= blocks[block].size;
+        blocks[block].state = Free;
+
+        Block previous = blocks[block].previous;
+        Block next = blocks[block].next;
+
+        if (next != none && blocks[next].state == Free) {
+            removeFree(next);
+            absorb(block, next);
+        }
+
+        if (previous != none && blocks[previous].state == Free) {
+            removeFree(previous);
+            absorb(previous, block);
+            block = previous;
+        }
+
+        insertFree(block);
+    }
+
+    size_t offset(Block block) const {
+        return blocks[block].offset;
+    }
+
+    size_t size(Block block) const {
+        return blocks[block].size;
+    }
+
+    //  A pinned block stays where it is when compacting, e.g. while a free waits on the GPU
+    void pin(Block block, bool pinned) {
+        blocks[block].state = pinned ? Pinned : Used;
+    }
+
+    //  Move used blocks towards offset 0 so the free space gathers at the end.
+    //  Each step swaps a free block with the used block right after it, which
+    //  merges the free block with whatever free space follows. Stops after about
+    //  `budget` bytes were moved, so it can be spread over frames. A block keeps
+    //  the alignment it was allocated with, the padding in front of it stays
+    //  free. `move(block, from, to, size)` is called before each block changes
+    //  its offset
+    template <typename Move>
+    size_t compact(size_t budget, Move move) {
+
+        size_t moved = 0;
+        Block gap = head;
+
+        while (gap != none && moved < budget) {
+
+            if (blocks[gap].state != Free) {
+                gap = blocks[gap].next;
+                continue;
+            }
+
+            Block block = blocks[gap].next;
+
+            //  a pinned block cannot move, look for the next gap after it
+            if (block == none || blocks[block].state != Used) {
+                gap = block;
+                continue;
+            }
+
+            size_t from = blocks[block].offset;
+            size_t to = roundUp(blocks[gap].offset, blocks[block].alignment);
+
+            //  the gap is smaller than the padding the alignment needs, leave the block
+            if (to >= from) {
+                gap = block;
+                continue;
+            }
+
+            move(block, from, to, blocks[block].size);
+            moved += blocks[block].size;
+
+            removeFree(gap);
+
+            //  the padding stays free in front of the block, the swap uses the rest
+            if (to > blocks[gap].offset) {
+                Block rest = split(gap, to - blocks[gap].offset);
+                insertFree(gap);
+                gap = rest;
+            }
+
+            //  swap the two in physical order: previous, block, gap, next
+            Block previous = blocks[gap].previous;
+            Block next = blocks[block].next;
+
+            blocks[block].offset = to;
+            blocks[gap].offset = to + blocks[block].size;
+
+            blocks[block].previous = previous;
+            blocks[block].next = gap;
+            blocks[gap].previous = block;
+            blocks[gap].next = next;
+
+            if (previous != none) blocks[previous].next = block; else head = block;
+            if (next != none) blocks[next].previous = gap;
+
+            if (next != none && blocks[next].state == Free) {
+                removeFree(next);
+                absorb(gap, next);
+            }
+
+            insertFree(gap);
+        }
+
+        return moved;
+    }
+
+    //  Walks the free blocks, for the metrics
+    size_t largestFree() const {
+
+        size_t largest = 0;
+        for (Block block = head; block != none; block = blocks[block].next) {
+            if (blocks[block].state == Free) largest = std::max(largest, blocks[block].size);
+        }
+        return largest;
+    }
+
+    size_t freeBlocks() const {
+
+        size_t count = 0;
+        for (Block block = head; block != none; block = blocks[block].next) {
+            if (blocks[block].state == Free) count++;
+        }
+        return count;
+    }
+
+private:
+
+    static constexpr int slBits = 4;
+    static constexpr int slCount = 1 << slBits;
+    static constexpr int flCount = 40;
+
+    enum State : uint8_t { Free, Used, Pinned };
+
+    struct Node {
+        size_t offset = 0;
+        size_t size = 0;
+        Block previous = none, next = none;             //  neighbours by offset
+        Block previousFree = none, nextFree = none;     //  neighbours in the size class list
+        size_t alignment = granularity;                 //  kept by `compact` when the block moves
+        State state = Free;
+    };
+
+    std::vector<Node> blocks;
+    std::vector<Block> unusedNodes;
+    Block head = none;                                  //  the block at offset 0
+
+    uint64_t flBitmap = 0;
+    uint32_t slBitmaps[flCount];
+    Block heads[flCount][slCount];
+
+    static size_t roundUp(size_t value, size_t multiple) {
+        return (value + multiple - 1) / multiple * multiple;
+    }
+
+    static int highestBit(uint64_t value) {
+        return 63 - __builtin_clzll(value);
+    }
+
+    static int lowestBit(uint64_t value) {
+        return __builtin_ctzll(value);
+    }
+
+    //  Size class of a free block of `size` bytes. Sizes below 16 granules each
+    //  get a class of their own on the first level
+    static void mapping(size_t size, int& fl, int& sl) {
+
+        size_t units = size / granularity;
+
+        if (units < (size_t)slCount) {
+            fl = 0;
+            sl = (int)units;
+        } else {
+            int bit = highestBit(units);
+            fl = bit - slBits + 1;
+            sl = (int)(units >> (bit - slBits)) - slCount;
+        }
+    }
+
+    //  First free block of at least `size` bytes. The size is rounded up to the
+    //  next class first, so any block of the class found is large enough
+    Block findFree(size_t size) {
+
+        size_t units = size / granularity;
+
+        if (units >= (size_t)slCount) {
+            units += ((size_t)1 << (highestBit(units) - slBits)) - 1;
+        }
+
+        int fl, sl;
+        mapping(units * granularity, fl, sl);
+        if (fl >= flCount) return none;
+
+        uint32_t slMap = slBitmaps[fl] & (~0u << sl);
+
+        if (slMap == 0) {
+            uint64_t flMap = flBitmap & (~0ull << (fl + 1));
+            if (flMap == 0) return none;
+
+            fl = lowestBit(flMap);
+            slMap = slBitmaps[fl];
+        }
+
+        return heads[fl][lowestBit(slMap)];
+    }
+
+    void insertFree(Block block) {
+
+        int fl, sl;
+        mapping(blocks[block].size, fl, sl);
+
+        Node& node = blocks[block];
+        node.state = Free;
+        node.previousFree = none;
+        node.nextFree = heads[fl][sl];
+
+        if (node.nextFree != none) blocks[node.nextFree].previousFree = block;
+        heads[fl][sl] = block;
+
+        flBitmap |= 1ull << fl;
+        slBitmaps[fl] |= 1u << sl;
+    }
+
+    void removeFree(Block block) {
+
+        int fl, sl;
+        mapping(blocks[block].size, fl, sl);
+
+        Node& node = blocks[block];
+        if (node.previousFree != none) blocks[node.previousFree].nextFree = node.nextFree;
+        if (node.nextFree != none) blocks[node.nextFree].previousFree = node.previousFree;
+
+        if (heads[fl][sl] == block) {
+            heads[fl][sl] = node.nextFree;
+
+            if (heads[fl][sl] == none) {
+                slBitmaps[fl] &= ~(1u << sl);
+                if (slBitmaps[fl] == 0) flBitmap &= ~(1ull << fl);
+            }
+        }
+
+        node.previousFree = node.nextFree = none;
+    }
+
+    //  Cut `block` after `size` bytes, the rest becomes a new block right after it
+    Block split(Block block, size_t size) {
+
+        Block rest = newNode();
+
+        blocks[rest].offset = blocks[block].offset + size;
+        blocks[rest].size = blocks[block].size - size;
+        blocks[rest].previous = block;
+        blocks[rest].next = blocks[block].next;
+
+        if (blocks[rest].next != none) blocks[blocks[rest].next].previous = rest;
+
+        blocks[block].size = size;
+        blocks[block].next = rest;
+        return rest;
+    }
+
+    //  Merge `next`, the physical successor of `block`, into `block`
+    void absorb(Block block, Block next) {
+
+        blocks[block].size += blocks[next].size;
+        blocks[block].next = blocks[next].next;
+
+        if (blocks[block].next != none) blocks[blocks[block].next].previous = block;
+
+        unusedNodes.push_back(next);
+    }
+
+    Block newNode() {
+
+        if (!unusedNodes.empty()) {
+            Block block = unusedNodes.back();
+            unusedNodes.pop_back();
+            blocks[block] = Node();
+            return block;
+        }
+
+        blocks.push_back(Node());
+        return (Block)(blocks.size() - 1);
+    }
+
+};
+
+//  Sub-allocates ranges of one large GL buffer, e.g. for the vertices and indices
+//  of many meshes, instead of a buffer object per mesh.
+//
+//  Frees are deferred: the range stays reserved until a fence placed at the end
+//  of the frame that freed it has signaled, so new data never overwrites what the
+//  GPU may still be reading. `defragment` slides live ranges towards the start of
+//  the buffer with glCopyBufferSubData, a few per call, so the free space ends up
+//  in one piece. Ranges can move, which is why callers hold an Allocation and ask
+//  for its current offset instead of keeping the offset itself. Offsets are only
+//  stable between calls to `defragment`.
+//
+//      allocation = allocator.allocate(bytes, 256);
+//      allocator.upload(allocation, data, bytes);
+//      ...draw from allocator.offset(allocation)...
+//      allocator.free(allocation);
+//      allocator.endFrame();                           //  once per frame
+//      allocator.defragment(1 << 20);                  //  when convenient
+class BufferAllocator {
+
+public:
+
+    //  Stays valid while the range moves, blocks keep their id when compacted
+    struct Allocation {
+        TLSFAllocator::Block block = TLSFAllocator::none;
+
+        bool valid() const {
+            return block != TLSFAllocator::none;
+        }
+    };
+
+    //  Counters for `report`
+    struct Stats {
+        unsigned long allocations = 0;
+        unsigned long failures = 0;         //  no free block was large enough
+        unsigned long frees = 0;
+        unsigned long moves = 0;            //  ranges moved by `defragment`
+        size_t bytesMoved = 0;
+    };
+
+    BufferHandle buffer;
+    Stats stats;
+
+    //  Reserve `capacity` bytes of GPU memory with `usage` (e.g. GL_STATIC_DRAW)
+    void create(size_t capacity, GLenum usage = GL_STATIC_DRAW) {
+
+        ranges.create(capacity);
+
+        buffer = GLResources::createBuffer();
+        glBindBuffer(GL_COPY_WRITE_BUFFER, GLResources::get(buffer));
+        glBufferData(GL_COPY_WRITE_BUFFER, ranges.capacity, NULL, usage);
+    }
+
+    //  An invalid Allocation when the buffer has no room, `defragment` may make some
+    Allocation allocate(size_t size, size_t alignment = TLSFAllocator::granularity) {
+
+        Allocation allocation;
+        allocation.block = ranges.allocate(size, alignment);
+
+        if (allocation.valid()) {
+            stats.allocations++;
+        } else {
+            stats.failures++;
+        }
+
+        return allocation;
+    }
+
+    //  Byte offset of the range inside `buffer`, changes when it is defragmented
+    size_t offset(Allocation allocation) const {
+        return ranges.offset(allocation.block);
+    }
+
+    //  Bytes reserved, the requested size rounded up to the granularity
+    size_t size(Allocation allocation) const {
+        return ranges.size(allocation.block);
+    }
+
+    void upload(Allocation allocation, const void* data, size_t size, size_t at = 0) {
+
+        if (at + size > this->size(allocation)) {
+            throw std::runtime_error("BufferAllocator: upload past the end of the allocation");
+        }
+
+        glBindBuffer(GL_COPY_WRITE_BUFFER, GLResources::get(buffer));
+        glBufferSubData(GL_COPY_WRITE_BUFFER, offset(allocation) + at, size, data);
+    }
+
+    //  The allocation is invalid right away, its range is reused once the GPU is done with it
+    void free(Allocation& allocation) {
+
+        ranges.pin(allocation.block, true);
+        pendingFrees.push_back(allocation.block);
+        allocation = Allocation();
+        stats.frees++;
+    }
+
+    //  Fence the frees of this frame and release those whose fence signaled
+    void endFrame() {
+
+        if (!pendingFrees.empty()) {
+            Retirement retirement;
+            retirement.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            retirement.blocks.swap(pendingFrees);
+            retiring.push_back(std::move(retirement));
+        }
+
+        //  fences signal in order, stop at the first one that has not
+        while (!retiring.empty()) {
+
+            GLenum status = glClientWaitSync(retiring.front().fence, 0, 0);
+            if (status == GL_TIMEOUT_EXPIRED) break;
+
+            release(retiring.front());
+            retiring.pop_front();
+        }
+    }
+
+    //  Move up to about `budget` bytes of live ranges towards the start of the
+    //  buffer. Returns the bytes moved, 0 once there is nothing left to gain
+    size_t defragment(size_t budget) {
+
+        glBindBuffer(GL_COPY_READ_BUFFER, GLResources::get(buffer));
+        glBindBuffer(GL_COPY_WRITE_BUFFER, GLResources::get(buffer));
+
+        size_t moved = ranges.compact(budget, [this](TLSFAllocator::Block, size_t from, size_t to, size_t size) {
+
+            //  a copy within one buffer must not overlap, larger moves bounce through a scratch buffer
+            if (from - to >= size) {
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, from, to, size);
+            } else {
+                bounce(from, to, size);
+            }
+
+            stats.moves++;
+            stats.bytesMoved += size;
+        });
+
+        return moved;
+    }
+
+    //  Share of the buffer handed out (including ranges waiting on a fence)
+    double utilization() const {
+        return ranges.capacity ? (double)ranges.used / ranges.capacity : 0.0;
+    }
+
+    //  0 when all free space is one block, towards 1 the more it is scattered
+    double fragmentation() const {
+
+        size_t free = ranges.capacity - ranges.used;
+        return free ? 1.0 - (double)ranges.largestFree() / free : 0.0;
+    }
+
+    size_t pending() const {
+
+        size_t count = pendingFrees.size();
+        for (const Retirement& retirement : retiring) count += retirement.blocks.size();
+        return count;
+    }
+
+    void report() const {
+
+        std::printf("buffer allocator: %.1f / %.1f KB used (%.1f%%), %zu free blocks, largest %.1f KB, "
+            "fragmentation %.1f%%, %zu frees pending, %lu allocations (%lu failed), %lu moves (%.1f KB)\n",
+            ranges.used / 1024.0, ranges.capacity / 1024.0, utilization() * 100.0, ranges.freeBlocks(),
+            ranges.largestFree() / 1024.0, fragmentation() * 100.0, pending(),
+            stats.allocations, stats.failures, stats.moves, stats.bytesMoved / 1024.0);
+    }
+
+    //  Waits for nothing: the buffers go back to GLResources, which deletes
+    //  them once the frames drawing from them are done
+    void destroy() {
+
+        for (Retirement& retirement : retiring) glDeleteSync(retirement.fence);
+        retiring.clear();
+        pendingFrees.clear();
+
+        GLResources::destroy(buffer);
+        GLResources::destroy(scratch);
+        scratchSize = 0;
+    }
+
+private:
+
+    //  frees of one frame, released when its fence signals
+    struct Retirement {
+        GLsync fence = 0;
+        std::vector<TLSFAllocator::Block> blocks;
+    };
+
+    TLSFAllocator ranges;
+
+    std::vector<TLSFAllocator::Block> pendingFrees;
+    std::deque<Retirement> retiring;
+
+    BufferHandle scratch;
+    size_t scratchSize = 0;
+
+    void release(Retirement& retirement) {
+
+        glDeleteSync(retirement.fence);
+
+        for (TLSFAllocator::Block block : retirement.blocks) {
+            ranges.free(block);
+        }
+    }
+
+    void bounce(size_t from, size_t to, size_t size) {
+
+        if (scratchSize < size) {
+            if (!scratch.valid()) scratch = GLResources::createBuffer();
+            scratchSize = std::max(size, scratchSize * 2);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, GLResources::get(scratch));
+            glBufferData(GL_COPY_WRITE_BUFFER, scratchSize, NULL, GL_STREAM_COPY);
+        }
+
+        glBindBuffer(GL_COPY_WRITE_BUFFER, GLResources::get(scratch));
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, from, 0, size);
+
+        glBindBuffer(GL_COPY_READ_BUFFER, GLResources::get(scratch));
+        glBindBuffer(GL_COPY_WRITE_BUFFER, GLResources::get(buffer));
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, to, size);
+
+        glBindBuffer(GL_COPY_READ_BUFFER, GLResources::get(buffer));
+    }
+
+};
+
+#endif
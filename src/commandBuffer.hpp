@@ -0,0 +1,388 @@
+#ifndef COMMAND_BUFFER_H
+#define COMMAND_BUFFER_H
+
+#include "glad/glad.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+//  GL calls recorded as data, so threads without the context can prepare them.
+//  A command is a 4 byte header followed by its arguments, all packed into one
+//  linear arena: recording is a bump of the write position and a memcpy, and
+//  `clear` keeps the memory for the next frame. `execute` replays a range of the
+//  arena on the thread that owns the context
+//
+//      buffer.bindProgram(program);
+//      buffer.uniform4fv(location, transform);
+//      buffer.drawArrays(GL_TRIANGLES, 0, 3);
+//      ...
+//      buffer.execute(0, buffer.position());       //  GL thread
+class CommandBuffer {
+
+public:
+
+    enum Type : uint16_t {
+        BindProgram,
+        BindVertexArray,
+        BindBufferRange,
+        Uniform1f,
+        Uniform3f,
+        Uniform4f,
+        DrawArrays,
+        DrawElements
+    };
+
+    //  commands recorded since the last `clear`
+    size_t commands = 0;
+
+    void bindProgram(GLuint program) {
+        write(BindProgram, program);
+    }
+
+    void bindVertexArray(GLuint vao) {
+        write(BindVertexArray, vao);
+    }
+
+    void bindBufferRange(GLenum target, GLuint index, GLuint buffer, uint32_t offset, uint32_t size) {
+        write(BindBufferRange, BufferRangeArgs{target, index, buffer, offset, size});
+    }
+
+    void uniform1f(GLint location, float value) {
+        write(Uniform1f, UniformArgs<1>{location, {value}});
+    }
+
+    void uniform3fv(GLint location, const float* value) {
+        write(Uniform3f, UniformArgs<3>{location, {value[0], value[1], value[2]}});
+    }
+
+    void uniform4fv(GLint location, const float* value) {
+        write(Uniform4f, UniformArgs<4>{location, {value[0], value[1], value[2], value[3]}});
+    }
+
+    void drawArrays(GLenum mode, GLint first, GLsizei count) {
+        write(DrawArrays, DrawArraysArgs{mode, first, count});
+    }
+
+    //  `offset` is the byte offset into the bound element buffer
+    void drawElements(GLenum mode, GLsizei count, GLenum type, uint32_t offset) {
+        write(DrawElements, DrawElementsArgs{mode, count, type, offset});
+    }
+
+    //  Write position, marks where the next command goes
+    size_t position() const {
+        return used;
+    }
+
+    //  Bytes of arena reserved so far, kept across `clear`
+    size_t capacity() const {
+        return arena.size();
+    }
+
+    void clear() {
+        used = 0;
+        commands = 0;
+    }
+
+    //  Issue the commands in [begin, end). Needs the context to be current
+    void execute(size_t begin, size_t end) const {
+
+        const unsigned char* cursor = arena.data() + begin;
+        const unsigned char* last = arena.data() + end;
+
+        while (cursor < last) {
+
+            Header header;
+            std::memcpy(&header, cursor, sizeof(header));
+            const unsigned char* args = cursor + sizeof(header);
+
+            switch (header.type) {
+            case BindProgram: {
+                GLuint program = read<GLuint>(args);
+                glUseProgram(program);
+                break;
+            }
+            case BindVertexArray: {
+                GLuint vao = read<GLuint>(args);
+                glBindVertexArray(vao);
+                break;
+            }
+            case BindBufferRange: {
+                BufferRangeArgs range = read<BufferRangeArgs>(args);
+                glBindBufferRange(range.target, range.index, range.buffer, range.offset, range.size);
+                break;
+            }
+            case Uniform1f: {
+                UniformArgs<1> uniform = read<UniformArgs<1>>(args);
+                glUniform1f(uniform.location, uniform.value[0]);
+                break;
+            }
+            case Uniform3f: {
+                UniformArgs<3> uniform = read<UniformArgs<3>>(args);
+                glUniform3fv(uniform.location, 1, uniform.value);
+                break;
+            }
+            case Uniform4f: {
+                UniformArgs<4> uniform = read<UniformArgs<4>>(args);
+                glUniform4fv(uniform.location, 1, uniform.value);
+                break;
+            }
+            case DrawArrays: {
+                DrawArraysArgs draw = read<DrawArraysArgs>(args);
+                glDrawArrays(draw.mode, draw.first, draw.count);
+                break;
+            }
+            case DrawElements: {
+                DrawElementsArgs draw = read<DrawElementsArgs>(args);
+                glDrawElements(draw.mode, draw.count, draw.type, (const void*)(uintptr_t)draw.offset);
+                break;
+            }
+            default:
+                throw std::runtime_error("CommandBuffer: corrupt command stream");
+            }
+
+            cursor += header.size;
+        }
+    }
+
+private:
+
+    //  `size` covers header and arguments, so unknown commands could be skipped
+    struct Header {
+        uint16_t type;
+        uint16_t size;
+    };
+
+    struct BufferRangeArgs { GLenum target; GLuint index; GLuint buffer; uint32_t offset; uint32_t size; };
+    template <int N> struct UniformArgs { GLint location; float value[N]; };
+    struct DrawArraysArgs { GLenum mode; GLint first; GLsizei count; };
+    struct DrawElementsArgs { GLenum mode; GLsizei count; GLenum type; uint32_t offset; };
+
+    std::vector<unsigned char> arena;
+    size_t used = 0;
+
+    template <typename Args>
+    void write(Type type, const Args& args) {
+
+        static_assert(sizeof(Args) % 4 == 0, "CommandBuffer: arguments must keep 4 byte alignment");
+
+        const size_t size = sizeof(Header) + sizeof(Args);
+
+        //  grow geometrically, a warmed-up buffer never allocates again
+        if (used + size > arena.size()) {
+            arena.resize(std::max<size_t>(arena.size() * 2, std::max<size_t>(used + size, 4096)));
+        }
+
+        Header header = {(uint16_t)type, (uint16_t)size};
+        std::memcpy(&arena[used], &header, sizeof(header));
+        std::memcpy(&arena[used + sizeof(header)], &args, sizeof(args));
+
+        used += size;
+        commands++;
+    }
+
+    template <typename Args>
+    static Args read(const unsigned char* data) {
+
+        Args args;
+        std::memcpy(&args, data, sizeof(args));
+        return args;
+    }
+
+};
+
+//  Records a frame's commands on a pool of worker threads and replays them on
+//  the GL thread. The frame is split into jobs (e.g. a slice of the scene each);
+//  every thread, the caller included, claims jobs and records them into its own
+//  CommandBuffer, so recording never contends on memory. Each job's range is kept
+//  by job index, and `replay` walks them in that order, so the GL sees the same
+//  stream however the jobs were spread over the threads.
+//
+//  Jobs cannot rely on state left by the job before them: a job that draws
+//  should bind its program and VAO first. GLStateCache drops the repeats on replay
+//
+//      recorder.record(numJobs, [&](size_t job, CommandBuffer& buffer) {
+//          ...record the objects of slice `job`...
+//      });
+//      recorder.replay();
+class CommandRecorder {
+
+public:
+
+    //  `workers` threads besides the caller, by default one per additional core
+    explicit CommandRecorder(unsigned int workers = defaultWorkers()) {
+
+        buffers.resize(workers + 1);
+
+        for (unsigned int i = 0; i < workers; i++) {
+            threads.emplace_back(&CommandRecorder::workerLoop, this, i + 1);
+        }
+    }
+
+    ~CommandRecorder() {
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+
+        wake.notify_all();
+
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+
+    CommandRecorder(const CommandRecorder&) = delete;
+    CommandRecorder& operator=(const CommandRecorder&) = delete;
+
+    //  Threads recording, the caller included
+    unsigned int threadCount() const {
+        return (unsigned int)buffers.size();
+    }
+
+    //  Run `recordJob` for jobs 0 .. numJobs - 1 across the pool and wait for all of
+    //  them. Replaces whatever the previous call recorded
+    void record(size_t numJobs, const std::function<void(size_t job, CommandBuffer& buffer)>& recordJob) {
+
+        for (CommandBuffer& buffer : buffers) {
+            buffer.clear();
+        }
+
+        segments.assign(numJobs, Segment());
+        jobCount = numJobs;
+        job = &recordJob;
+        nextJob.store(0, std::memory_order_relaxed);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            busyWorkers = (unsigned int)threads.size();
+            generation++;
+        }
+
+        wake.notify_all();
+
+        recordJobs(0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this]() { return busyWorkers == 0; });
+
+        job = NULL;
+
+        if (failure) {
+            std::exception_ptr error = failure;
+            failure = NULL;
+            std::rethrow_exception(error);
+        }
+    }
+
+    //  Issue everything from the last `record`, in job order. Needs the context
+    void replay() const {
+
+        for (const Segment& segment : segments) {
+            buffers[segment.buffer].execute(segment.begin, segment.end);
+        }
+    }
+
+    size_t commands() const {
+
+        size_t total = 0;
+        for (const CommandBuffer& buffer : buffers) total += buffer.commands;
+        return total;
+    }
+
+    size_t bytes() const {
+
+        size_t total = 0;
+        for (const CommandBuffer& buffer : buffers) total += buffer.position();
+        return total;
+    }
+
+    static unsigned int defaultWorkers() {
+
+        unsigned int cores = std::thread::hardware_concurrency();
+        return cores > 1 ? cores - 1 : 0;
+    }
+
+private:
+
+    //  where one job's commands ended up
+    struct Segment {
+        unsigned int buffer = 0;
+        size_t begin = 0;
+        size_t end = 0;
+    };
+
+    std::vector<CommandBuffer> buffers;     //  one per thread, [0] is the caller's
+    std::vector<Segment> segments;          //  one per job
+    std::vector<std::thread> threads;
+
+    const std::function<void(size_t, CommandBuffer&)>* job = NULL;
+    size_t jobCount = 0;
+    std::atomic<size_t> nextJob{0};
+
+    std::mutex mutex;
+    std::condition_variable wake;           //  a new `record` started, or stopping
+    std::condition_variable done;           //  a worker ran out of jobs
+    unsigned long generation = 0;
+    unsigned int busyWorkers = 0;
+    bool stopping = false;
+    std::exception_ptr failure;
+
+    void workerLoop(unsigned int index) {
+
+        unsigned long seen = 0;
+
+        while (true) {
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&]() { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+            }
+
+            recordJobs(index);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                busyWorkers--;
+            }
+
+            done.notify_one();
+        }
+    }
+
+    //  Claim jobs until none are left, recording into this thread's buffer
+    void recordJobs(unsigned int index) {
+
+        CommandBuffer& buffer = buffers[index];
+        size_t claimed;
+
+        while ((claimed = nextJob.fetch_add(1, std::memory_order_relaxed)) < jobCount) {
+
+            Segment& segment = segments[claimed];
+            segment.buffer = index;
+            segment.begin = buffer.position();
+
+            try {
+                (*job)(claimed, buffer);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!failure) failure = std::current_exception();
+            }
+
+            segment.end = buffer.position();
+        }
+    }
+
+};
+
+#endif
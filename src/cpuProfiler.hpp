@@ -0,0 +1,165 @@
+#ifndef CPU_PROFILER_H
+#define CPU_PROFILER_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//  Low overhead CPU profiler.
+//  Zones are recorded into a fixed size ring buffer owned by the calling thread,
+//  so recording takes no lock and never allocates; when a buffer is full the
+//  oldest zones are overwritten. `writeTrace` dumps every buffer as a Chrome
+//  trace (chrome://tracing, ui.perfetto.dev)
+class CPUProfiler {
+
+public:
+
+    //  zones kept per thread
+    static const size_t bufferCapacity = 1 << 16;
+
+    struct Zone {
+        const char* name;       //  must outlive the profiler, string literals in practice
+        uint64_t begin;         //  nanoseconds since the profiler's epoch
+        uint64_t end;
+    };
+
+    struct ThreadBuffer {
+        std::vector<Zone> zones;
+        size_t next = 0;        //  slot the next zone is written to
+        size_t count = 0;
+        unsigned int threadId = 0;
+    };
+
+    static bool& enabled() {
+        static bool value = false;
+        return value;
+    }
+
+    static void enable() {
+        epoch();
+        enabled() = true;
+    }
+
+    static uint64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - epoch()).count();
+    }
+
+    static void record(const char* name, uint64_t begin, uint64_t end) {
+
+        ThreadBuffer& buffer = threadBuffer();
+
+        Zone& zone = buffer.zones[buffer.next];
+        zone.name = name;
+        zone.begin = begin;
+        zone.end = end;
+
+        buffer.next = (buffer.next + 1) % bufferCapacity;
+        if (buffer.count < bufferCapacity) buffer.count++;
+    }
+
+    //  Write all recorded zones as complete ("X") events of the Chrome trace
+    //  event format. Other threads should not be recording while this runs
+    static void writeTrace(const std::string& path) {
+
+        FILE* file = std::fopen(path.c_str(), "w");
+
+        if (file == NULL) {
+            throw std::runtime_error("Failed To Open " + path);
+        }
+
+        std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+        std::lock_guard<std::mutex> lock(registryMutex());
+        bool first = true;
+
+        for (size_t i = 0; i < registry().size(); i++) {
+
+            const ThreadBuffer& buffer = *registry()[i];
+            size_t oldest = (buffer.next + bufferCapacity - buffer.count) % bufferCapacity;
+
+            for (size_t j = 0; j < buffer.count; j++) {
+
+                const Zone& zone = buffer.zones[(oldest + j) % bufferCapacity];
+
+                //  timestamps are in microseconds
+                std::fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                    first ? "" : ",\n", zone.name, buffer.threadId, zone.begin / 1e3, (zone.end - zone.begin) / 1e3);
+                first = false;
+            }
+        }
+
+        std::fprintf(file, "\n]}\n");
+        std::fclose(file);
+    }
+
+private:
+
+    static std::chrono::steady_clock::time_point epoch() {
+        static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        return start;
+    }
+
+    static std::mutex& registryMutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    //  buffers stay alive after their thread exits so they can still be exported
+    static std::vector<std::unique_ptr<ThreadBuffer> >& registry() {
+        static std::vector<std::unique_ptr<ThreadBuffer> > buffers;
+        return buffers;
+    }
+
+    static ThreadBuffer& threadBuffer() {
+
+        static thread_local ThreadBuffer* buffer = NULL;
+
+        if (buffer == NULL) {
+            std::unique_ptr<ThreadBuffer> created(new ThreadBuffer());
+            created->zones.resize(bufferCapacity);
+
+            std::lock_guard<std::mutex> lock(registryMutex());
+            created->threadId = (unsigned int)registry().size() + 1;
+            buffer = created.get();
+            registry().push_back(std::move(created));
+        }
+
+        return *buffer;
+    }
+
+};
+
+//  Records the time between its construction and destruction as a zone
+class CPUZone {
+
+public:
+
+    explicit CPUZone(const char* _name) : name(_name), active(CPUProfiler::enabled()), begin(0) {
+        if (active) begin = CPUProfiler::now();
+    }
+
+    ~CPUZone() {
+        if (active) CPUProfiler::record(name, begin, CPUProfiler::now());
+    }
+
+private:
+
+    const char* name;
+    bool active;
+    uint64_t begin;
+
+};
+
+#define CPU_ZONE_CONCAT_(a, b) a##b
+#define CPU_ZONE_CONCAT(a, b) CPU_ZONE_CONCAT_(a, b)
+
+//  Profile the rest of the enclosing block: CPU_ZONE("draw");
+#define CPU_ZONE(name) CPUZone CPU_ZONE_CONCAT(cpuZone, __LINE__)(name)
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef EMBEDDED_SHADERS_H
+#define EMBEDDED_SHADERS_H
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+//  Shader source compiled into the executable, so startup needs no file I/O
+//  and does not depend on the working directory
+struct EmbeddedShader {
+    const char* path;       //  "shaders/<file>", the path the file would be loaded from
+    const char* source;     //  null terminated
+    size_t size;
+};
+
+//  embeddedShaderTable, generated from src/shaders by cmake/embedShaders.cmake
+#include "embeddedShaderTable.hpp"
+
+constexpr const EmbeddedShader* findEmbeddedShader(std::string_view path) {
+
+    for (const EmbeddedShader& shader : embeddedShaderTable) {
+        if (path == shader.path) return &shader;
+    }
+
+    return nullptr;
+}
+
+inline const EmbeddedShader& embeddedShader(const char* path) {
+
+    const EmbeddedShader* shader = findEmbeddedShader(path);
+
+    if (shader == nullptr) {
+        throw std::runtime_error(std::string("No embedded shader ") + path);
+    }
+
+    return *shader;
+}
+
+#endif
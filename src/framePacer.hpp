@@ -0,0 +1,200 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+//  Keeps frames on a fixed cadence and measures how well that worked.
+//  With a frame-rate cap the limiter sleeps until shortly before the deadline,
+//  since the OS may wake a sleeping thread late, and spins the rest of the
+//  way. Deadlines advance by exactly one period, so an early or late frame does
+//  not shift every frame after it. Frames that overrun are counted and logged,
+//  and the time of every frame goes into a histogram that can be written as CSV
+//
+//      pacer.start();
+//      while (...) {
+//          ...draw, swap...
+//          pacer.endFrame();       //  waits for the deadline when capped
+//      }
+//      pacer.report(); pacer.writeHistogram("frames.csv");
+class FramePacer {
+
+public:
+
+    typedef std::chrono::steady_clock Clock;
+
+    //  histogram buckets of 0.25 ms up to 100 ms, slower frames share the last one
+    static constexpr double bucketMs = 0.25;
+    static constexpr int numBuckets = 400;
+
+    //  time left before a deadline that is spun instead of slept
+    static constexpr double spinMs = 1.5;
+
+    //  0 leaves the frame rate uncapped
+    double targetFps = 0.0;
+
+    unsigned long frames = 0;
+    unsigned long missed = 0;
+
+    //  Call once, right before the first frame
+    void start() {
+
+        histogram.assign(numBuckets + 1, 0);
+        frameStart = Clock::now();
+        deadline = frameStart + period();
+        started = true;
+    }
+
+    //  Call after the frame was presented. Records its time and, when capped,
+    //  waits for the next deadline
+    void endFrame() {
+
+        if (!started) start();
+
+        if (targetFps > 0.0) {
+            waitUntil(deadline);
+        }
+
+        Clock::time_point now = Clock::now();
+        double ms = std::chrono::duration<double, std::milli>(now - frameStart).count();
+        record(ms);
+
+        if (targetFps > 0.0) {
+            //  more than a period behind: start a new cadence from now instead of
+            //  rushing through frames to catch up
+            deadline += period();
+            if (deadline < now) deadline = now + period();
+        } else if (frames > 8 && ms > 2.0 * averageMs()) {
+            //  uncapped there is no deadline, a frame twice the average is a hitch
+            late(ms, averageMs());
+        }
+
+        frameStart = now;
+    }
+
+    //  Forget the time since the last frame, e.g. after idling for events,
+    //  so the pause is neither recorded nor treated as a missed deadline
+    void resync() {
+
+        frameStart = Clock::now();
+        deadline = frameStart + period();
+    }
+
+    double averageMs() const {
+        return frames ? totalMs / frames : 0.0;
+    }
+
+    //  Frame time at which `fraction` of the frames were at least as fast,
+    //  read from the histogram so it is accurate to a bucket and never above
+    //  the slowest frame. Frames past the last bucket report `maxMs`
+    double percentileMs(double fraction) const {
+
+        unsigned long target = (unsigned long)(fraction * frames);
+        unsigned long count = 0;
+
+        for (int i = 0; i <= numBuckets; i++) {
+            count += histogram[i];
+            if (count > target) return i < numBuckets ? std::min((i + 1) * bucketMs, maxMs) : maxMs;
+        }
+
+        return maxMs;
+    }
+
+    void report() const {
+
+        if (frames == 0) return;
+
+        std::printf("frame pacing: %lu frames, avg %.3f ms, p50 %.2f ms, p99 %.2f ms, max %.3f ms, %lu missed",
+            frames, averageMs(), percentileMs(0.5), percentileMs(0.99), maxMs, missed);
+
+        if (targetFps > 0.0) {
+            std::printf(" (cap %.1f fps)", targetFps);
+        }
+
+        std::printf("\n");
+    }
+
+    //  CSV with one row per non-empty bucket: lower bound in ms, frame count
+    void writeHistogram(const std::string& path) const {
+
+        FILE* file = std::fopen(path.c_str(), "w");
+
+        if (file == NULL) {
+            throw std::runtime_error("Failed To Open " + path);
+        }
+
+        std::fprintf(file, "frame_ms,count\n");
+
+        for (int i = 0; i <= numBuckets; i++) {
+            if (histogram[i]) std::fprintf(file, "%.2f,%lu\n", i * bucketMs, histogram[i]);
+        }
+
+        std::fclose(file);
+    }
+
+private:
+
+    bool started = false;
+    Clock::time_point frameStart;
+    Clock::time_point deadline;
+
+    std::vector<unsigned long> histogram;
+    double totalMs = 0.0;
+    double maxMs = 0.0;
+
+    //  log the first few misses, then only every 100th so a slow scene does not flood the console
+    static constexpr unsigned long loggedMisses = 10;
+
+    Clock::duration period() const {
+
+        if (targetFps <= 0.0) return Clock::duration::zero();
+        return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / targetFps));
+    }
+
+    void record(double ms) {
+
+        int bucket = std::min((int)(ms / bucketMs), numBuckets);
+        histogram[bucket]++;
+
+        frames++;
+        totalMs += ms;
+        maxMs = std::max(maxMs, ms);
+
+        //  the frame ended after its deadline
+        if (targetFps > 0.0 && Clock::now() > deadline + std::chrono::microseconds(500)) {
+            late(ms, 1000.0 / targetFps);
+        }
+    }
+
+    void late(double ms, double budgetMs) {
+
+        missed++;
+
+        if (missed <= loggedMisses || missed % 100 == 0) {
+            std::printf("frame %lu late: %.3f ms against %.3f ms (%lu missed so far)\n", frames, ms, budgetMs, missed);
+        }
+    }
+
+    //  Sleep through most of the wait, the scheduler may oversleep by a
+    //  millisecond or more, then spin for the exact deadline
+    static void waitUntil(Clock::time_point target) {
+
+        Clock::time_point wake = target - std::chrono::microseconds((long)(spinMs * 1000));
+
+        if (Clock::now() < wake) {
+            std::this_thread::sleep_until(wake);
+        }
+
+        while (Clock::now() < target) {
+            std::this_thread::yield();
+        }
+    }
+
+};
+
+#endif
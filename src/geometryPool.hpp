@@ -0,0 +1,174 @@
+#ifndef GEOMETRY_POOL_H
+#define GEOMETRY_POOL_H
+
+#include "glad/glad.h"
+#include "glResources.hpp"
+#include "mesh.hpp"
+#include "vertexLayout.hpp"
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+//  Many meshes in one vertex buffer and one index buffer behind a single VAO.
+//  Each mesh gets a range of both buffers; its indices stay relative to its own
+//  first vertex and the range's base vertex is added at draw time, so meshes can
+//  be packed in any order. Meshes drawn with the same program then go out in one
+//  glMultiDrawElementsBaseVertex call instead of a VAO bind and draw per mesh.
+//
+//      pool.create(maxVertices, maxIndices);
+//      GeometryPool::Range range = pool.add(mesh);
+//      ...
+//      batch.add(range);
+//      pool.draw(batch);
+class GeometryPool {
+
+public:
+
+    //  Where a mesh lives in the pool
+    struct Range {
+        GLint baseVertex = 0;
+        uint32_t firstIndex = 0;
+        GLsizei indexCount = 0;
+        uint32_t vertexCount = 0;
+    };
+
+    //  Draws collected for one multi-draw, reused across frames
+    class Batch {
+
+    public:
+
+        void add(const Range& range) {
+            counts.push_back(range.indexCount);
+            offsets.push_back((const void*)(uintptr_t)(range.firstIndex * sizeof(uint32_t)));
+            baseVertices.push_back(range.baseVertex);
+        }
+
+        void clear() {
+            counts.clear();
+            offsets.clear();
+            baseVertices.clear();
+        }
+
+        size_t size() const {
+            return counts.size();
+        }
+
+    private:
+
+        friend class GeometryPool;
+
+        std::vector<GLsizei> counts;
+        std::vector<const void*> offsets;
+        std::vector<GLint> baseVertices;
+
+    };
+
+    //  Vertices are in PositionColorLayout, indices 32 bit
+    using Layout = PositionColorLayout;
+
+    //  owned through GLResources, `destroy` hands them back
+    VertexArrayHandle VAO;
+    BufferHandle VBO;
+    BufferHandle EBO;
+
+    void create(size_t _maxVertices, size_t _maxIndices) {
+
+        maxVertices = _maxVertices;
+        maxIndices = _maxIndices;
+        usedVertices = usedIndices = 0;
+
+        VAO = GLResources::createVertexArray();
+        bindVAO();
+
+        VBO = GLResources::createBuffer();
+        glBindBuffer(GL_ARRAY_BUFFER, GLResources::get(VBO));
+        glBufferData(GL_ARRAY_BUFFER, maxVertices * Layout::stride, NULL, GL_STATIC_DRAW);
+
+        //  the element buffer binding is VAO state
+        EBO = GLResources::createBuffer();
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, GLResources::get(EBO));
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, maxIndices * sizeof(uint32_t), NULL, GL_STATIC_DRAW);
+
+        Layout::apply();
+    }
+
+    //  Copy `mesh` to the end of the pool
+    Range add(const Mesh& mesh) {
+
+        if ((size_t)mesh.vertexStride * sizeof(float) != Layout::stride) {
+            throw std::runtime_error("GeometryPool: mesh vertices do not match the pool layout");
+        }
+
+        size_t vertexCount = mesh.vertexCount();
+
+        if (usedVertices + vertexCount > maxVertices || usedIndices + mesh.indices.size() > maxIndices) {
+            throw std::runtime_error("GeometryPool: out of space");
+        }
+
+        Range range;
+        range.baseVertex = (GLint)usedVertices;
+        range.firstIndex = (uint32_t)usedIndices;
+        range.indexCount = (GLsizei)mesh.indices.size();
+        range.vertexCount = (uint32_t)vertexCount;
+
+        glBindBuffer(GL_ARRAY_BUFFER, GLResources::get(VBO));
+        glBufferSubData(GL_ARRAY_BUFFER, usedVertices * Layout::stride, vertexCount * Layout::stride, mesh.vertices.data());
+
+        bindVAO();
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, GLResources::get(EBO));
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, usedIndices * sizeof(uint32_t), mesh.indices.size() * sizeof(uint32_t), mesh.indices.data());
+
+        usedVertices += vertexCount;
+        usedIndices += mesh.indices.size();
+        return range;
+    }
+
+    void bindVAO() {
+        glBindVertexArray(GLResources::get(VAO));
+    }
+
+    //  One mesh on its own, e.g. one that needs uniforms of its own
+    void draw(const Range& range) {
+
+        bindVAO();
+        glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT,
+            (const void*)(uintptr_t)(range.firstIndex * sizeof(uint32_t)), range.baseVertex);
+    }
+
+    //  Every mesh of `batch` in a single call
+    void draw(const Batch& batch) {
+
+        if (batch.size() == 0) return;
+
+        bindVAO();
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, batch.counts.data(), GL_UNSIGNED_INT,
+            batch.offsets.data(), (GLsizei)batch.size(), batch.baseVertices.data());
+    }
+
+    //  Fraction of the vertex / index storage handed out
+    double vertexUsage() const {
+        return maxVertices ? (double)usedVertices / maxVertices : 0.0;
+    }
+
+    double indexUsage() const {
+        return maxIndices ? (double)usedIndices / maxIndices : 0.0;
+    }
+
+    void destroy() {
+
+        GLResources::destroy(VBO);
+        GLResources::destroy(EBO);
+        GLResources::destroy(VAO);
+        usedVertices = usedIndices = 0;
+    }
+
+private:
+
+    size_t maxVertices = 0;
+    size_t maxIndices = 0;
+    size_t usedVertices = 0;
+    size_t usedIndices = 0;
+
+};
+
+#endif
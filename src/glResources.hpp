@@ -0,0 +1,282 @@
+#ifndef GL_RESOURCES_H
+#define GL_RESOURCES_H
+
+#include "glad/glad.h"
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <vector>
+
+//  Reference to a GL object in GLResources: a slot index plus the generation
+//  the slot had when the object was created. Destroying the object bumps the
+//  generation, so a handle kept past that resolves to 0 instead of to whatever
+//  object the slot (or the driver, with the GL name) is reused for next.
+//  The tag keeps handles of different object types apart
+template <typename Tag>
+struct Handle {
+
+    uint32_t index = 0;
+    uint32_t generation = 0;        //  0 is never handed out, it marks a null handle
+
+    bool valid() const {
+        return generation != 0;
+    }
+
+};
+
+struct VertexArrayTag {};
+struct BufferTag {};
+struct ProgramTag {};
+
+using VertexArrayHandle = Handle<VertexArrayTag>;
+using BufferHandle = Handle<BufferTag>;
+using ProgramHandle = Handle<ProgramTag>;
+
+//  Slots of one object type. Freed slots are reused, with a new generation
+template <typename Tag>
+class ResourceTable {
+
+public:
+
+    size_t live = 0;
+
+    Handle<Tag> add(GLuint name) {
+
+        uint32_t index;
+
+        if (!unused.empty()) {
+            index = unused.back();
+            unused.pop_back();
+        } else {
+            index = (uint32_t)slots.size();
+            slots.push_back(Slot());
+        }
+
+        slots[index].name = name;
+        live++;
+
+        Handle<Tag> handle;
+        handle.index = index;
+        handle.generation = slots[index].generation;
+        return handle;
+    }
+
+    //  GL name of a live handle, 0 for a null or stale one
+    GLuint get(Handle<Tag> handle) const {
+
+        if (!handle.valid() || handle.index >= slots.size()) return 0;
+
+        const Slot& slot = slots[handle.index];
+        return slot.generation == handle.generation ? slot.name : 0;
+    }
+
+    //  Retire the slot and return the GL name it held, 0 when the handle was stale
+    GLuint remove(Handle<Tag> handle) {
+
+        GLuint name = get(handle);
+        if (name == 0) return 0;
+
+        Slot& slot = slots[handle.index];
+        slot.name = 0;
+
+        //  skip 0 on wrap-around, it would make old handles look null
+        if (++slot.generation == 0) slot.generation = 1;
+
+        unused.push_back(handle.index);
+        live--;
+        return name;
+    }
+
+    //  Every live name, e.g. to delete what is left at shutdown
+    template <typename Visit>
+    void forEach(Visit visit) const {
+
+        for (const Slot& slot : slots) {
+            if (slot.name != 0) visit(slot.name);
+        }
+    }
+
+    void clear() {
+        slots.clear();
+        unused.clear();
+        live = 0;
+    }
+
+private:
+
+    struct Slot {
+        GLuint name = 0;
+        uint32_t generation = 1;
+    };
+
+    std::vector<Slot> slots;
+    std::vector<uint32_t> unused;
+
+};
+
+//  Owner of the VAOs, buffers and programs of the app, handed out as handles.
+//  `destroy` invalidates the handle right away but only queues the GL object:
+//  it is deleted once a fence placed by `endFrame` after the last frame that
+//  could have used it has signaled, so deleting while the GPU still renders
+//  with an object never makes the driver wait. `shutdown` deletes whatever is
+//  left, queued or leaked, before the context goes away.
+//
+//      BufferHandle vbo = GLResources::createBuffer();
+//      glBindBuffer(GL_ARRAY_BUFFER, GLResources::get(vbo));
+//      ...
+//      GLResources::destroy(vbo);          //  vbo is null from here on
+//      GLResources::endFrame();            //  once per frame
+class GLResources {
+
+public:
+
+    //  GL objects deleted so far
+    inline static unsigned long deleted = 0;
+
+    static VertexArrayHandle createVertexArray() {
+
+        GLuint name = 0;
+        glGenVertexArrays(1, &name);
+        return vertexArrays.add(name);
+    }
+
+    static BufferHandle createBuffer() {
+
+        GLuint name = 0;
+        glGenBuffers(1, &name);
+        return buffers.add(name);
+    }
+
+    //  Programs come from glCreateProgram (or a cache load) inside Shader
+    static ProgramHandle adoptProgram(GLuint name) {
+        return programs.add(name);
+    }
+
+    static GLuint get(VertexArrayHandle handle) {
+        return vertexArrays.get(handle);
+    }
+
+    static GLuint get(BufferHandle handle) {
+        return buffers.get(handle);
+    }
+
+    static GLuint get(ProgramHandle handle) {
+        return programs.get(handle);
+    }
+
+    //  Queue the object for deletion and null the handle. Stale and null handles are ignored
+    static void destroy(VertexArrayHandle& handle) {
+        queue(VertexArray, vertexArrays.remove(handle));
+        handle = VertexArrayHandle();
+    }
+
+    static void destroy(BufferHandle& handle) {
+        queue(Buffer, buffers.remove(handle));
+        handle = BufferHandle();
+    }
+
+    static void destroy(ProgramHandle& handle) {
+        queue(Program, programs.remove(handle));
+        handle = ProgramHandle();
+    }
+
+    //  Call after the frame's last draw: fence what was destroyed during the frame
+    //  and delete the objects of every earlier frame whose fence has signaled
+    static void endFrame() {
+
+        if (!pending.empty()) {
+            Retirement retirement;
+            retirement.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            retirement.objects.swap(pending);
+            retiring.push_back(std::move(retirement));
+        }
+
+        //  fences signal in order, stop at the first one that has not
+        while (!retiring.empty()) {
+
+            if (glClientWaitSync(retiring.front().fence, 0, 0) == GL_TIMEOUT_EXPIRED) break;
+
+            glDeleteSync(retiring.front().fence);
+            deleteObjects(retiring.front().objects);
+            retiring.pop_front();
+        }
+    }
+
+    //  Objects destroyed but not deleted yet
+    static size_t queued() {
+
+        size_t count = pending.size();
+        for (const Retirement& retirement : retiring) count += retirement.objects.size();
+        return count;
+    }
+
+    //  Delete everything still alive or queued. The context is about to be
+    //  destroyed, so nothing waits on fences. Live objects are leaks and are counted
+    static void shutdown() {
+
+        for (Retirement& retirement : retiring) {
+            glDeleteSync(retirement.fence);
+            deleteObjects(retirement.objects);
+        }
+
+        retiring.clear();
+        deleteObjects(pending);
+        pending.clear();
+
+        size_t leaked = vertexArrays.live + buffers.live + programs.live;
+
+        vertexArrays.forEach([](GLuint name) { glDeleteVertexArrays(1, &name); });
+        buffers.forEach([](GLuint name) { glDeleteBuffers(1, &name); });
+        programs.forEach([](GLuint name) { glDeleteProgram(name); });
+
+        vertexArrays.clear();
+        buffers.clear();
+        programs.clear();
+
+        if (deleted + leaked > 0) {
+            std::printf("GL resources: %lu deleted, %zu still alive at shutdown\n", deleted, leaked);
+        }
+    }
+
+private:
+
+    enum Type : uint8_t { VertexArray, Buffer, Program };
+
+    struct Queued {
+        Type type;
+        GLuint name;
+    };
+
+    //  objects destroyed during one frame and the fence after it
+    struct Retirement {
+        GLsync fence = 0;
+        std::vector<Queued> objects;
+    };
+
+    inline static ResourceTable<VertexArrayTag> vertexArrays;
+    inline static ResourceTable<BufferTag> buffers;
+    inline static ResourceTable<ProgramTag> programs;
+
+    inline static std::vector<Queued> pending;         //  destroyed this frame
+    inline static std::deque<Retirement> retiring;     //  waiting for their fence
+
+    static void queue(Type type, GLuint name) {
+        if (name != 0) pending.push_back(Queued{type, name});
+    }
+
+    static void deleteObjects(const std::vector<Queued>& objects) {
+
+        for (const Queued& object : objects) {
+            switch (object.type) {
+            case VertexArray: glDeleteVertexArrays(1, &object.name); break;
+            case Buffer: glDeleteBuffers(1, &object.name); break;
+            case Program: glDeleteProgram(object.name); break;
+            }
+        }
+
+        deleted += objects.size();
+    }
+
+};
+
+#endif
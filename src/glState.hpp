@@ -0,0 +1,264 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include "glad/glad.h"
+#include <cstdio>
+
+//  Shadow copy of the GL binding state, sitting in front of the glad function
+//  pointers. `install` swaps glad_glUseProgram, glad_glBindVertexArray, ... for
+//  filters that only forward a call when it changes something, so every caller
+//  (Shader, GraphicsPipeline, the render loop) benefits without being changed.
+//  Only valid for a single context on a single thread
+class GLStateCache {
+
+public:
+
+    //  Calls that reached the driver vs calls dropped because they were redundant
+    struct Counters {
+        unsigned long issued;
+        unsigned long filtered;
+    };
+
+    //  initialized here, default member initializers would not be usable yet
+    inline static Counters frame = {0, 0};      //  since the last `endFrame`
+    inline static Counters total = {0, 0};      //  since `install`
+
+    //  Replace the glad pointers with the filtering versions.
+    //  Has to run after gladLoadGLLoader
+    static void install() {
+
+        if (installed) return;
+
+        realUseProgram = glad_glUseProgram;
+        realBindVertexArray = glad_glBindVertexArray;
+        realBindBuffer = glad_glBindBuffer;
+        realEnable = glad_glEnable;
+        realDisable = glad_glDisable;
+        realDeleteProgram = glad_glDeleteProgram;
+        realDeleteVertexArrays = glad_glDeleteVertexArrays;
+        realDeleteBuffers = glad_glDeleteBuffers;
+        realBindBufferRange = glad_glBindBufferRange;
+        realBindBufferBase = glad_glBindBufferBase;
+
+        glad_glUseProgram = useProgram;
+        glad_glBindVertexArray = bindVertexArray;
+        glad_glBindBuffer = bindBuffer;
+        glad_glEnable = enable;
+        glad_glDisable = disable;
+        glad_glDeleteProgram = deleteProgram;
+        glad_glDeleteVertexArrays = deleteVertexArrays;
+        glad_glDeleteBuffers = deleteBuffers;
+        glad_glBindBufferRange = bindBufferRange;
+        glad_glBindBufferBase = bindBufferBase;
+
+        invalidate();
+        installed = true;
+    }
+
+    //  Forget everything, the next call of each kind goes to the driver.
+    //  Use after state was changed behind the cache's back (e.g. by another library)
+    static void invalidate() {
+
+        program = unknown;
+        vertexArray = unknown;
+        for (int i = 0; i < numBufferTargets; i++) buffers[i] = unknown;
+        for (int i = 0; i < numCapabilities; i++) capabilities[i] = -1;
+    }
+
+    //  Print and reset the per-frame counters
+    static void endFrame(bool print = false) {
+
+        if (print) {
+            std::printf("GL state: %lu calls issued, %lu filtered this frame\n", frame.issued, frame.filtered);
+        }
+
+        frame = Counters();
+    }
+
+    //  Totals since `install`, averaged over `frames` rendered frames
+    static void report(unsigned int frames) {
+
+        if (!installed) return;
+
+        unsigned long calls = total.issued + total.filtered;
+        double percent = calls ? 100.0 * total.filtered / calls : 0.0;
+        double perFrame = frames ? 1.0 / frames : 0.0;
+
+        std::printf("GL state cache: %lu calls, %lu issued, %lu filtered (%.1f%%), per frame %.1f issued / %.1f filtered\n",
+            calls, total.issued, total.filtered, percent, total.issued * perFrame, total.filtered * perFrame);
+    }
+
+private:
+
+    static const unsigned int unknown = 0xFFFFFFFFu;
+
+    //  bind targets that are tracked, everything else is passed straight through
+    enum { ArrayBuffer, ElementArrayBuffer, UniformBuffer, CopyReadBuffer, CopyWriteBuffer, numBufferTargets };
+
+    //  capabilities that are tracked by glEnable / glDisable
+    enum { Blend, CullFace, DepthTest, ScissorTest, StencilTest, numCapabilities };
+
+    inline static bool installed = false;
+    inline static unsigned int program = unknown;
+    inline static unsigned int vertexArray = unknown;
+    inline static unsigned int buffers[numBufferTargets];
+    inline static int capabilities[numCapabilities];
+
+    inline static PFNGLUSEPROGRAMPROC realUseProgram = NULL;
+    inline static PFNGLBINDVERTEXARRAYPROC realBindVertexArray = NULL;
+    inline static PFNGLBINDBUFFERPROC realBindBuffer = NULL;
+    inline static PFNGLENABLEPROC realEnable = NULL;
+    inline static PFNGLDISABLEPROC realDisable = NULL;
+    inline static PFNGLDELETEPROGRAMPROC realDeleteProgram = NULL;
+    inline static PFNGLDELETEVERTEXARRAYSPROC realDeleteVertexArrays = NULL;
+    inline static PFNGLDELETEBUFFERSPROC realDeleteBuffers = NULL;
+    inline static PFNGLBINDBUFFERRANGEPROC realBindBufferRange = NULL;
+    inline static PFNGLBINDBUFFERBASEPROC realBindBufferBase = NULL;
+
+    static bool changed(unsigned int& current, unsigned int value) {
+
+        if (current == value) {
+            frame.filtered++;
+            total.filtered++;
+            return false;
+        }
+
+        current = value;
+        frame.issued++;
+        total.issued++;
+        return true;
+    }
+
+    static int bufferSlot(GLenum target) {
+
+        switch (target) {
+            case GL_ARRAY_BUFFER: return ArrayBuffer;
+            case GL_ELEMENT_ARRAY_BUFFER: return ElementArrayBuffer;
+            case GL_UNIFORM_BUFFER: return UniformBuffer;
+            case GL_COPY_READ_BUFFER: return CopyReadBuffer;
+            case GL_COPY_WRITE_BUFFER: return CopyWriteBuffer;
+            default: return -1;
+        }
+    }
+
+    static int capabilitySlot(GLenum cap) {
+
+        switch (cap) {
+            case GL_BLEND: return Blend;
+            case GL_CULL_FACE: return CullFace;
+            case GL_DEPTH_TEST: return DepthTest;
+            case GL_SCISSOR_TEST: return ScissorTest;
+            case GL_STENCIL_TEST: return StencilTest;
+            default: return -1;
+        }
+    }
+
+    static void APIENTRY useProgram(GLuint id) {
+        if (changed(program, id)) realUseProgram(id);
+    }
+
+    //  the element array binding is part of the VAO, so switching VAOs
+    //  leaves it unknown
+    static void APIENTRY bindVertexArray(GLuint id) {
+
+        if (changed(vertexArray, id)) {
+            buffers[ElementArrayBuffer] = unknown;
+            realBindVertexArray(id);
+        }
+    }
+
+    static void APIENTRY bindBuffer(GLenum target, GLuint id) {
+
+        int slot = bufferSlot(target);
+
+        if (slot < 0) {
+            total.issued++;
+            frame.issued++;
+            realBindBuffer(target, id);
+        } else if (changed(buffers[slot], id)) {
+            realBindBuffer(target, id);
+        }
+    }
+
+    //  Indexed bindings are not tracked, but binding one also binds the buffer
+    //  to the generic target, which the shadow copy has to follow
+    static void APIENTRY bindBufferRange(GLenum target, GLuint index, GLuint id, GLintptr offset, GLsizeiptr size) {
+
+        int slot = bufferSlot(target);
+        if (slot >= 0) buffers[slot] = id;
+
+        total.issued++;
+        frame.issued++;
+        realBindBufferRange(target, index, id, offset, size);
+    }
+
+    static void APIENTRY bindBufferBase(GLenum target, GLuint index, GLuint id) {
+
+        int slot = bufferSlot(target);
+        if (slot >= 0) buffers[slot] = id;
+
+        total.issued++;
+        frame.issued++;
+        realBindBufferBase(target, index, id);
+    }
+
+    static void setCapability(GLenum cap, int value) {
+
+        int slot = capabilitySlot(cap);
+
+        if (slot >= 0 && capabilities[slot] == value) {
+            frame.filtered++;
+            total.filtered++;
+            return;
+        }
+
+        if (slot >= 0) capabilities[slot] = value;
+        frame.issued++;
+        total.issued++;
+
+        if (value) realEnable(cap); else realDisable(cap);
+    }
+
+    static void APIENTRY enable(GLenum cap) {
+        setCapability(cap, 1);
+    }
+
+    static void APIENTRY disable(GLenum cap) {
+        setCapability(cap, 0);
+    }
+
+    //  deleting a bound object resets the binding to 0 and the name may be reused,
+    //  so the shadow copy has to follow
+
+    static void APIENTRY deleteProgram(GLuint id) {
+        //  a program in use stays current until another one is used, only forget it
+        if (program == id) program = unknown;
+        realDeleteProgram(id);
+    }
+
+    static void APIENTRY deleteVertexArrays(GLsizei n, const GLuint* ids) {
+
+        for (GLsizei i = 0; i < n; i++) {
+            if (ids[i] != 0 && vertexArray == ids[i]) {
+                vertexArray = 0;
+                buffers[ElementArrayBuffer] = unknown;
+            }
+        }
+
+        realDeleteVertexArrays(n, ids);
+    }
+
+    static void APIENTRY deleteBuffers(GLsizei n, const GLuint* ids) {
+
+        for (GLsizei i = 0; i < n; i++) {
+            for (int slot = 0; slot < numBufferTargets; slot++) {
+                if (ids[i] != 0 && buffers[slot] == ids[i]) buffers[slot] = 0;
+            }
+        }
+
+        realDeleteBuffers(n, ids);
+    }
+
+};
+
+#endif
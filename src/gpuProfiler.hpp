@@ -0,0 +1,214 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include "glad/glad.h"
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+//  Measures how long the GPU spends inside named scopes using GL_TIMESTAMP
+//  queries (glQueryCounter, core since 3.3). Each scope writes a timestamp when
+//  it opens and one when it closes, so scopes can nest, which GL_TIME_ELAPSED
+//  queries cannot.
+//  Queries of a frame are only read back `frameLatency` frames later, by which
+//  time the GPU has normally finished them, so reading never stalls the pipeline
+class GPUProfiler {
+
+public:
+
+    static const int frameLatency = 4;
+
+    bool enabled = false;
+
+    //  frames whose results were not ready after `frameLatency` frames, forcing a wait
+    unsigned int stalls = 0;
+
+    void enable() {
+
+        int bits = 0;
+        glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+
+        if (bits == 0) {
+            std::printf("GPU profiler: GL_TIMESTAMP queries are not supported, disabled\n");
+            return;
+        }
+
+        enabled = true;
+    }
+
+    void beginFrame() {
+
+        if (!enabled) return;
+
+        //  the slot is about to be reused, collect what it measured frameLatency frames ago
+        Frame& frame = frames[frameIndex % frameLatency];
+        resolve(frame);
+
+        frame.scopes.clear();
+        frame.nextQuery = 0;
+        openScopes.clear();
+    }
+
+    void pushScope(const char* name) {
+
+        if (!enabled) return;
+
+        Frame& frame = frames[frameIndex % frameLatency];
+
+        Scope scope;
+        scope.path = openScopes.empty() ? std::string(name) : frame.scopes[openScopes.back()].path + "/" + name;
+        scope.beginQuery = acquireQuery(frame);
+        scope.endQuery = 0;
+
+        glQueryCounter(scope.beginQuery, GL_TIMESTAMP);
+
+        openScopes.push_back(frame.scopes.size());
+        frame.scopes.push_back(scope);
+    }
+
+    void popScope() {
+
+        if (!enabled || openScopes.empty()) return;
+
+        Frame& frame = frames[frameIndex % frameLatency];
+        Scope& scope = frame.scopes[openScopes.back()];
+        openScopes.pop_back();
+
+        scope.endQuery = acquireQuery(frame);
+        glQueryCounter(scope.endQuery, GL_TIMESTAMP);
+    }
+
+    void endFrame() {
+
+        if (!enabled) return;
+
+        frameIndex++;
+    }
+
+    //  Drain the frames still in flight and print min / avg / p99 per scope.
+    //  Needs the context to still be current
+    void report() {
+
+        if (!enabled) return;
+
+        //  oldest first, waiting on these at shutdown is not a stall
+        for (int i = 0; i < frameLatency; i++) {
+            resolve(frames[(frameIndex + i) % frameLatency], false);
+        }
+
+        std::printf("GPU profile over %u frames (%u stalled readbacks)\n", frameIndex, stalls);
+        std::printf("%-32s %10s %10s %10s %8s\n", "scope", "min ms", "avg ms", "p99 ms", "samples");
+
+        for (size_t i = 0; i < order.size(); i++) {
+
+            std::vector<double>& samples = results[order[i]];
+            std::sort(samples.begin(), samples.end());
+
+            double sum = 0.0;
+            for (size_t j = 0; j < samples.size(); j++) sum += samples[j];
+
+            size_t p99 = std::min(samples.size() - 1, (size_t)(samples.size() * 0.99));
+
+            std::printf("%-32s %10.3f %10.3f %10.3f %8zu\n", order[i].c_str(),
+                samples.front(), sum / samples.size(), samples[p99], samples.size());
+        }
+
+        for (int i = 0; i < frameLatency; i++) {
+            if (!frames[i].queries.empty()) {
+                glDeleteQueries((GLsizei)frames[i].queries.size(), &frames[i].queries[0]);
+            }
+            frames[i] = Frame();
+        }
+
+        enabled = false;
+    }
+
+private:
+
+    struct Scope {
+        std::string path;       //  "frame/draw" for a "draw" scope opened inside "frame"
+        unsigned int beginQuery;
+        unsigned int endQuery;
+    };
+
+    //  Queries of one frame. Query objects are kept and reused once the slot comes around again
+    struct Frame {
+        std::vector<Scope> scopes;
+        std::vector<unsigned int> queries;
+        size_t nextQuery = 0;
+    };
+
+    Frame frames[frameLatency];
+    unsigned int frameIndex = 0;
+    std::vector<size_t> openScopes;
+
+    //  milliseconds per scope path, plus the order paths were first seen in for the report
+    std::map<std::string, std::vector<double> > results;
+    std::vector<std::string> order;
+
+    unsigned int acquireQuery(Frame& frame) {
+
+        if (frame.nextQuery == frame.queries.size()) {
+            unsigned int query;
+            glGenQueries(1, &query);
+            frame.queries.push_back(query);
+        }
+
+        return frame.queries[frame.nextQuery++];
+    }
+
+    void resolve(Frame& frame, bool countStalls = true) {
+
+        if (frame.scopes.empty()) return;
+
+        //  queries complete in order, so the last one issued being ready means all of them are
+        int available = 0;
+        glGetQueryObjectiv(frame.queries[frame.nextQuery - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available && countStalls) stalls++;
+
+        for (size_t i = 0; i < frame.scopes.size(); i++) {
+
+            const Scope& scope = frame.scopes[i];
+            if (scope.endQuery == 0) continue;      //  never closed
+
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(scope.beginQuery, GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(scope.endQuery, GL_QUERY_RESULT, &end);
+
+            std::map<std::string, std::vector<double> >::iterator it = results.find(scope.path);
+
+            if (it == results.end()) {
+                it = results.insert(std::make_pair(scope.path, std::vector<double>())).first;
+                order.push_back(scope.path);
+            }
+
+            it->second.push_back((end - begin) / 1e6);
+        }
+
+        frame.scopes.clear();
+    }
+
+};
+
+//  Opens a GPU scope for the lifetime of the object
+class GPUScope {
+
+public:
+
+    GPUScope(GPUProfiler& _profiler, const char* name) : profiler(_profiler) {
+        profiler.pushScope(name);
+    }
+
+    ~GPUScope() {
+        profiler.popScope();
+    }
+
+private:
+
+    GPUProfiler& profiler;
+
+};
+
+#endif
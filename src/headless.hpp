@@ -0,0 +1,297 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include "glad/glad.h"
+#include "options.hpp"
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+#ifdef HAS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#ifdef HAS_OSMESA
+#include <GL/osmesa.h>
+#endif
+
+//  A GL context that is not attached to any window.
+//  Nothing is presented, so the default framebuffer is replaced with an
+//  FBO holding a color renderbuffer that the render loop draws into
+class HeadlessContext {
+
+public:
+
+    Backend backend;
+    int width;
+    int height;
+
+    unsigned int FBO = 0;
+    unsigned int colorRBO = 0;
+
+#ifdef HAS_EGL
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+#endif
+
+#ifdef HAS_OSMESA
+    OSMesaContext osmesaContext = NULL;
+
+    //  OSMesa insists on a client-side buffer to make the context current,
+    //  even though rendering goes to the FBO
+    std::vector<unsigned char> osmesaBuffer;
+#endif
+
+    HeadlessContext(Backend _backend, int _width, int _height)
+        : backend(_backend), width(_width), height(_height) {}
+
+    void create() {
+
+        if (backend == Backend::EGL) {
+            createEGLContext();
+        } else if (backend == Backend::OSMesa) {
+            createOSMesaContext();
+        } else {
+            throw std::runtime_error("HeadlessContext needs a headless backend");
+        }
+
+    }
+
+    //  Function pointer loader handed to glad
+    GLADloadproc procLoader() {
+
+#ifdef HAS_EGL
+        if (backend == Backend::EGL) return (GLADloadproc)eglGetProcAddress;
+#endif
+#ifdef HAS_OSMESA
+        if (backend == Backend::OSMesa) return (GLADloadproc)OSMesaGetProcAddress;
+#endif
+        return NULL;
+    }
+
+    //  Create the offscreen render target. Needs glad to be loaded
+    void createFramebuffer() {
+
+        glGenRenderbuffers(1, &colorRBO);
+        glBindRenderbuffer(GL_RENDERBUFFER, colorRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+        glGenFramebuffers(1, &FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRBO);
+
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            throw std::runtime_error("Offscreen Framebuffer Is Incomplete");
+        }
+
+        glViewport(0, 0, width, height);
+    }
+
+    //  Frames the CPU may queue ahead of the GPU
+    static const int framesInFlight = 2;
+
+    //  End of a frame. There is no swap chain to throttle the CPU, so every frame
+    //  gets a fence and the CPU only waits for the one `framesInFlight` frames
+    //  back: the GPU always has the next frame queued instead of idling while
+    //  the CPU records it, and queued work stays bounded
+    void finishFrame() {
+
+        GLsync& oldest = frameFences[nextFence];
+
+        if (oldest) {
+            //  the flush bit makes sure the fence is submitted and will signal
+            while (glClientWaitSync(oldest, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {}
+            glDeleteSync(oldest);
+        }
+
+        oldest = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        nextFence = (nextFence + 1) % framesInFlight;
+    }
+
+    //  Wait for every queued frame, e.g. before reading the last one back
+    void finish() {
+
+        glFinish();
+
+        for (GLsync& fence : frameFences) {
+            if (fence) glDeleteSync(fence);
+            fence = 0;
+        }
+    }
+
+    //  Bind the context to the calling thread, e.g. a render thread taking it over.
+    //  It must not be current on any other thread at the time (see `release`)
+    void makeCurrent() {
+
+#ifdef HAS_EGL
+        if (backend == Backend::EGL && !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+            throw std::runtime_error("Failed To Make EGL Context Current");
+        }
+#endif
+#ifdef HAS_OSMESA
+        if (backend == Backend::OSMesa &&
+            !OSMesaMakeCurrent(osmesaContext, &osmesaBuffer[0], GL_UNSIGNED_BYTE, width, height)) {
+            throw std::runtime_error("Failed To Make OSMesa Context Current");
+        }
+#endif
+    }
+
+    //  Unbind the context from the calling thread so another one can make it current
+    void release() {
+
+#ifdef HAS_EGL
+        if (backend == Backend::EGL) eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+#endif
+#ifdef HAS_OSMESA
+        if (backend == Backend::OSMesa) OSMesaMakeCurrent(NULL, NULL, GL_UNSIGNED_BYTE, 0, 0);
+#endif
+    }
+
+    //  Read the color attachment back and store it as a binary PPM image
+    void saveFrame(const std::string& path) {
+
+        std::vector<unsigned char> pixels(width * height * 4);
+
+        finish();
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+
+        FILE* file = std::fopen(path.c_str(), "wb");
+
+        if (file == NULL) {
+            throw std::runtime_error("Failed To Open " + path);
+        }
+
+        std::fprintf(file, "P6\n%d %d\n255\n", width, height);
+
+        //  GL rows start at the bottom of the image
+        for (int y = height - 1; y >= 0; y--) {
+            for (int x = 0; x < width; x++) {
+                std::fwrite(&pixels[(y * width + x) * 4], 1, 3, file);
+            }
+        }
+
+        std::fclose(file);
+    }
+
+    void destroy() {
+
+        if (FBO || colorRBO) finish();
+
+        if (FBO) glDeleteFramebuffers(1, &FBO);
+        if (colorRBO) glDeleteRenderbuffers(1, &colorRBO);
+        FBO = colorRBO = 0;
+
+#ifdef HAS_EGL
+        if (display != EGL_NO_DISPLAY) {
+            eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            if (context != EGL_NO_CONTEXT) eglDestroyContext(display, context);
+            eglTerminate(display);
+            display = EGL_NO_DISPLAY;
+            context = EGL_NO_CONTEXT;
+        }
+#endif
+#ifdef HAS_OSMESA
+        if (osmesaContext != NULL) {
+            OSMesaDestroyContext(osmesaContext);
+            osmesaContext = NULL;
+        }
+#endif
+    }
+
+private:
+
+    GLsync frameFences[framesInFlight] = {};
+    int nextFence = 0;
+
+    //  Mesa's surfaceless platform gives a display that needs neither an X server
+    //  nor a DRM device, and the context is made current without any surface
+    void createEGLContext() {
+
+#ifdef HAS_EGL
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+        if (getPlatformDisplay == NULL) {
+            throw std::runtime_error("EGL_EXT_platform_base Is Not Supported");
+        }
+
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL)) {
+            throw std::runtime_error("Failed To Initialize EGL Surfaceless Display");
+        }
+
+        if (!eglBindAPI(EGL_OPENGL_API)) {
+            throw std::runtime_error("EGL Does Not Support Desktop OpenGL");
+        }
+
+        //  the default surface type is EGL_WINDOW_BIT, which surfaceless has none of
+        const EGLint configAttributes[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_NONE
+        };
+
+        EGLConfig config;
+        EGLint numConfigs = 0;
+
+        if (!eglChooseConfig(display, configAttributes, &config, 1, &numConfigs) || numConfigs == 0) {
+            throw std::runtime_error("No Suitable EGL Config");
+        }
+
+        //  same version and profile the GLFW window asks for
+        const EGLint contextAttributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 3,
+            EGL_CONTEXT_MINOR_VERSION, 3,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+
+        if (context == EGL_NO_CONTEXT) {
+            throw std::runtime_error("Failed To Create EGL Context");
+        }
+
+        if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+            throw std::runtime_error("Failed To Make EGL Context Current");
+        }
+#else
+        throw std::runtime_error("Built Without EGL Support");
+#endif
+    }
+
+    void createOSMesaContext() {
+
+#ifdef HAS_OSMESA
+        const int attributes[] = {
+            OSMESA_FORMAT, OSMESA_RGBA,
+            OSMESA_PROFILE, OSMESA_CORE_PROFILE,
+            OSMESA_CONTEXT_MAJOR_VERSION, 3,
+            OSMESA_CONTEXT_MINOR_VERSION, 3,
+            0
+        };
+
+        osmesaContext = OSMesaCreateContextAttribs(attributes, NULL);
+
+        if (osmesaContext == NULL) {
+            throw std::runtime_error("Failed To Create OSMesa Context");
+        }
+
+        osmesaBuffer.resize(width * height * 4);
+
+        if (!OSMesaMakeCurrent(osmesaContext, &osmesaBuffer[0], GL_UNSIGNED_BYTE, width, height)) {
+            throw std::runtime_error("Failed To Make OSMesa Context Current");
+        }
+#else
+        throw std::runtime_error("Built Without OSMesa Support");
+#endif
+    }
+
+};
+
+#endif
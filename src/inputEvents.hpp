@@ -0,0 +1,91 @@
+#ifndef INPUT_EVENTS_H
+#define INPUT_EVENTS_H
+
+#include "spscQueue.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+//  A window event as the GLFW callbacks see it, copied so it can be applied later
+//  on the thread that owns the GL context
+struct InputEvent {
+
+    enum Type {
+        Key,            //  code = key, action = GLFW_PRESS / GLFW_RELEASE / GLFW_REPEAT
+        MouseButton,    //  code = button, action as for keys
+        CursorPos,      //  x, y in screen coordinates
+        Scroll,         //  x, y offsets
+        Resize,         //  code, action = framebuffer width, height
+        Refresh         //  the window contents were lost
+    };
+
+    Type type = Refresh;
+    int code = 0;
+    int action = 0;
+    int mods = 0;
+    double x = 0.0;
+    double y = 0.0;
+
+    //  when the callback ran, to measure how long the event waited for a frame
+    std::chrono::steady_clock::time_point time;
+
+};
+
+//  Carries input from the GLFW event thread (the only producer) to the render
+//  thread (the only consumer) without a lock, and keeps count of how long events
+//  sit in the queue before a frame picks them up
+class InputChannel {
+
+public:
+
+    //  a burst of cursor motion between two frames fits comfortably
+    static constexpr size_t capacity = 1024;
+
+    unsigned long pushed = 0;       //  event thread
+    unsigned long dropped = 0;      //  event thread, queue was full
+
+    unsigned long received = 0;     //  render thread
+    double totalLatencyMs = 0.0;
+    double maxLatencyMs = 0.0;
+
+    //  Event thread. A full queue means the render thread is far behind; the event
+    //  is dropped rather than blocking the thread that keeps the window responsive
+    void push(InputEvent event) {
+
+        event.time = std::chrono::steady_clock::now();
+
+        if (queue.push(event)) {
+            pushed++;
+        } else {
+            dropped++;
+        }
+    }
+
+    //  Render thread
+    bool pop(InputEvent& event) {
+
+        if (!queue.pop(event)) return false;
+
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - event.time).count();
+        received++;
+        totalLatencyMs += ms;
+        maxLatencyMs = std::max(maxLatencyMs, ms);
+        return true;
+    }
+
+    //  Call once both threads are done
+    void report() const {
+
+        if (pushed + dropped == 0) return;
+
+        std::printf("input queue: %lu events, %lu dropped, latency to the render thread avg %.3f ms, max %.3f ms\n",
+            pushed, dropped, received ? totalLatencyMs / received : 0.0, maxLatencyMs);
+    }
+
+private:
+
+    SPSCQueue<InputEvent, capacity> queue;
+
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "windowHandler.hpp"
+#include "benchmark.hpp"
 
 
 
@@ -9,6 +10,7 @@ class App {
 
 private:
     
+    AppOptions options;
     GraphicsPipeline pipeline;
     WindowHandler windowHandler;
     
@@ -17,16 +19,42 @@ public:
 
     Shader shader;
 
-    App(const char* vertexPath, const char* fragmentPath)
-        :shader(vertexPath, fragmentPath), windowHandler(shader)
+    //  file names of the shaders, looked up in `--watch-shaders` directory
+    std::string vertexName;
+    std::string fragmentName;
+
+    App(const char* vertexPath, const char* fragmentPath, const AppOptions& _options = AppOptions())
+        :options(_options), windowHandler(shader, options), shader(vertexPath, fragmentPath),
+        vertexName(fileName(vertexPath)), fragmentName(fileName(fragmentPath))
+    {}
+
+    App(const EmbeddedShader& vertex, const EmbeddedShader& fragment, const AppOptions& _options = AppOptions())
+        :options(_options), windowHandler(shader, options), shader(vertex, fragment),
+        vertexName(fileName(vertex.path)), fragmentName(fileName(fragment.path))
     {}
     
     void run() {
 
-        initWindow();
-        initGlad();
-        handlePipeline();
-        handleLoop();
+        if (!options.tracePath.empty()) {
+            CPUProfiler::enable();
+        }
+
+        {
+            CPU_ZONE("App::run");
+
+            initWindow();
+            initGlad();
+
+            if (!options.benchmark.empty()) {
+                Benchmark benchmark;
+                benchmark.meshPath = options.meshPath;
+                benchmark.run(options.benchmark);
+            } else {
+                handlePipeline();
+                handleLoop();
+            }
+        }
+
         clean();
 
         
@@ -40,9 +68,24 @@ public:
 
     //  manage function pointers
     void initGlad() {
-        if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        if (!gladLoadGLLoader(windowHandler.procLoader())) {
             throw std::runtime_error("Failed to Initialize GLAD");
         }
+
+        //  route binds through the shadow state before anything gets bound
+        if (options.stateCache) {
+            GLStateCache::install();
+        }
+
+        if (options.programCache) {
+            ProgramCache::enable(options.programCacheDir);
+        }
+
+        if (options.asyncShaders) {
+            Shader::enableParallelCompile();
+        }
+
+        windowHandler.createRenderTarget();
     }
 
     //  keep application alive    
@@ -50,32 +93,73 @@ public:
         windowHandler.renderLoop(pipeline);
     }
 
-    //  clean GLFW resources upon render loop exit
+    //  clean GLFW (or headless context) resources upon render loop exit
     void clean() {
+
+        if (!options.outputPath.empty()) {
+            windowHandler.saveFrame(options.outputPath);
+        }
+
+        GLStateCache::report(windowHandler.frameCount);
+        ProgramCache::report();
+
+        if (!options.tracePath.empty()) {
+            CPUProfiler::writeTrace(options.tracePath);
+        }
+
+        //  the context is still current: hand the objects back, windowHandler
+        //  deletes them before it destroys the context
+        pipeline.destroy();
+        shader.destroy();
      
-        glfwTerminate();
+        windowHandler.destroy();
     }
 
     void handlePipeline() {
 
-        shader.processShaders();
+        CPU_ZONE("handlePipeline");
+
+        //  async: the program builds while the pipeline is set up and the
+        //  render loop waits for it on the first useProgram
+        if (options.asyncShaders) {
+            shader.submitShaders();
+        } else {
+            shader.processShaders();
+        }
+
+        if (!options.meshPath.empty()) {
+            pipeline.loadObj(options.meshPath);
+        } else {
+            pipeline.indexVertices();
+        }
+
+        if (options.compactVertices) {
+            pipeline.compactVertices();
+        }
+
         pipeline.generateVAO();
         pipeline.handleVBO();
-        // // pipeline.handleEBO();
+        pipeline.handleEBO();
         pipeline.setVertexAttribute();
+
+        if (!options.watchShadersDir.empty()) {
+            windowHandler.shaderReloader.start(options.watchShadersDir, vertexName, fragmentName);
+        }
         
-        
+    }
+
+    static std::string fileName(const char* path) {
+        return std::filesystem::path(path).filename().string();
     }
 
 
 };
 
-int main() {
+int main(int argc, char** argv) {
 
-    App app("shaders/shader.vs", "shaders/shader.fs");
-    
     try
     {
+        App app(embeddedShader("shaders/shader.vs"), embeddedShader("shaders/shader.fs"), parseOptions(argc, argv));
         app.run();
     }
     catch(const std::exception& e)
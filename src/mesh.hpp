@@ -0,0 +1,125 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include "glad/glad.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+//  Interleaved vertices plus the indices that assemble them into triangles.
+//  Vertices shared by several triangles are stored once
+struct Mesh {
+
+    std::vector<float> vertices;
+    std::vector<uint32_t> indices;
+
+    //  floats per vertex, e.g. 6 for position + color
+    int vertexStride = 6;
+
+    //  GL_UNSIGNED_SHORT when every index fits in 16 bits, GL_UNSIGNED_INT otherwise
+    GLenum indexType = GL_UNSIGNED_INT;
+
+    size_t vertexCount() const {
+        return vertices.size() / vertexStride;
+    }
+
+    size_t indexSize() const {
+        return indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+    }
+
+    //  Bytes the mesh takes on the GPU, vertex and index buffer together
+    size_t gpuBytes() const {
+        return vertices.size() * sizeof(float) + indices.size() * indexSize();
+    }
+
+    //  Index data in the format of `indexType`, ready for glBufferData
+    std::vector<unsigned char> packedIndices() const {
+
+        std::vector<unsigned char> packed(indices.size() * indexSize());
+
+        if (indexType == GL_UNSIGNED_SHORT) {
+            uint16_t* out = (uint16_t*)packed.data();
+            for (size_t i = 0; i < indices.size(); i++) out[i] = (uint16_t)indices[i];
+        } else if (!indices.empty()) {
+            std::memcpy(packed.data(), indices.data(), packed.size());
+        }
+
+        return packed;
+    }
+
+};
+
+//  Build a Mesh from a triangle soup (every triangle lists its own three vertices)
+//  by welding bitwise identical vertices into one. Duplicates are found with an
+//  open-addressing hash table over the vertex bytes, so this is linear in the
+//  vertex count
+inline Mesh buildIndexedMesh(const std::vector<float>& soup, int vertexStride) {
+
+    Mesh mesh;
+    mesh.vertexStride = vertexStride;
+
+    size_t numVertices = soup.size() / vertexStride;
+    size_t vertexBytes = vertexStride * sizeof(float);
+
+    size_t capacity = 16;
+    while (capacity < numVertices * 2) capacity *= 2;
+
+    //  slot -> index of the unique vertex + 1, 0 marks an empty slot
+    std::vector<uint32_t> table(capacity, 0);
+    mesh.indices.reserve(numVertices);
+
+    for (size_t i = 0; i < numVertices; i++) {
+
+        const float* vertex = &soup[i * vertexStride];
+
+        //  64 bit FNV-1a over the raw bytes. +0.0 and -0.0 weld separately, which is harmless
+        uint64_t hash = 14695981039346656037ull;
+        const unsigned char* bytes = (const unsigned char*)vertex;
+        for (size_t b = 0; b < vertexBytes; b++) {
+            hash ^= bytes[b];
+            hash *= 1099511628211ull;
+        }
+
+        size_t slot = hash & (capacity - 1);
+
+        while (true) {
+
+            uint32_t entry = table[slot];
+
+            if (entry == 0) {
+                uint32_t index = (uint32_t)mesh.vertexCount();
+                mesh.vertices.insert(mesh.vertices.end(), vertex, vertex + vertexStride);
+                table[slot] = index + 1;
+                mesh.indices.push_back(index);
+                break;
+            }
+
+            if (std::memcmp(&mesh.vertices[(entry - 1) * vertexStride], vertex, vertexBytes) == 0) {
+                mesh.indices.push_back(entry - 1);
+                break;
+            }
+
+            slot = (slot + 1) & (capacity - 1);
+        }
+    }
+
+    mesh.indexType = mesh.vertexCount() <= 0xFFFF ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+    return mesh;
+}
+
+//  Print how much GPU memory indexing saved compared to drawing the soup directly
+inline void reportMeshSavings(const std::string& name, const Mesh& mesh, size_t soupVertexCount) {
+
+    size_t soupBytes = soupVertexCount * mesh.vertexStride * sizeof(float);
+    size_t meshBytes = mesh.gpuBytes();
+    long saved = (long)soupBytes - (long)meshBytes;
+
+    std::printf("mesh %s: %zu -> %zu vertices, %zu %d-bit indices, %zu -> %zu bytes (saved %ld bytes, %.1f%%)\n",
+        name.c_str(), soupVertexCount, mesh.vertexCount(), mesh.indices.size(), (int)mesh.indexSize() * 8,
+        soupBytes, meshBytes, saved, soupBytes ? 100.0 * saved / soupBytes : 0.0);
+}
+
+#endif
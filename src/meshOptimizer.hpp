@@ -0,0 +1,363 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include "mesh.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+//  Load-time reordering of indexed meshes so the GPU does less vertex work:
+//  1. vertex cache: order triangles so recently transformed vertices get reused
+//     (Tom Forsyth, "Linear-Speed Vertex Cache Optimisation")
+//  2. overdraw: cut the cache-friendly order into clusters and draw the clusters
+//     facing away from the mesh centre first, so they tend to occlude the rest
+//     (after Sander et al., "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw")
+//  3. vertex fetch: store vertices in the order the indices first use them
+//
+//  The first three floats of every vertex are taken as its position
+namespace MeshOptimizer {
+
+    //  Post-transform cache statistics of an index buffer, simulated with a FIFO
+    //  cache like the one found on most GPUs
+    struct CacheStats {
+        double acmr;    //  average cache miss ratio: transformed vertices per triangle (0.5 .. 3)
+        double atvr;    //  average transformed vertex ratio: transformed / unique vertices (1 is ideal)
+    };
+
+    inline CacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, size_t cacheSize = 16) {
+
+        std::vector<size_t> cachedAt(vertexCount, 0);     //  timestamp of the vertex's last load
+        size_t timestamp = cacheSize + 1;
+        size_t misses = 0;
+
+        for (size_t i = 0; i < indices.size(); i++) {
+
+            uint32_t vertex = indices[i];
+
+            //  in a FIFO cache an entry survives cacheSize further loads
+            if (timestamp - cachedAt[vertex] > cacheSize) {
+                cachedAt[vertex] = timestamp++;
+                misses++;
+            }
+        }
+
+        CacheStats stats;
+        size_t triangles = indices.size() / 3;
+        stats.acmr = triangles ? (double)misses / triangles : 0.0;
+        stats.atvr = vertexCount ? (double)misses / vertexCount : 0.0;
+        return stats;
+    }
+
+    //  Forsyth's greedy ordering: every vertex gets a score from its position in a
+    //  simulated LRU cache and from how many triangles still need it, and the
+    //  triangle with the highest summed score is emitted next
+    inline void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount) {
+
+        const int cacheSize = 32;
+        size_t numTriangles = indices.size() / 3;
+        if (numTriangles == 0) return;
+
+        //  triangles using each vertex, stored as one flat adjacency array
+        std::vector<uint32_t> remaining(vertexCount, 0);
+        for (size_t i = 0; i < indices.size(); i++) remaining[indices[i]]++;
+
+        std::vector<uint32_t> offsets(vertexCount + 1, 0);
+        for (size_t v = 0; v < vertexCount; v++) offsets[v + 1] = offsets[v] + remaining[v];
+
+        std::vector<uint32_t> adjacency(indices.size());
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t t = 0; t < numTriangles; t++) {
+            for (int k = 0; k < 3; k++) adjacency[fill[indices[t * 3 + k]]++] = (uint32_t)t;
+        }
+
+        std::vector<int> cachePosition(vertexCount, -1);
+        std::vector<float> vertexScore(vertexCount);
+        std::vector<float> triangleScore(numTriangles, 0.0f);
+        std::vector<bool> emitted(numTriangles, false);
+
+        //  score of a vertex given its cache position and remaining triangles
+        auto score = [&](uint32_t vertex) -> float {
+
+            if (remaining[vertex] == 0) return -1.0f;
+
+            float result = 0.0f;
+            int position = cachePosition[vertex];
+
+            if (position >= 0) {
+                //  the last triangle's vertices get a fixed score, so the order within it does not matter
+                if (position < 3) {
+                    result = 0.75f;
+                } else {
+                    float scale = 1.0f - (float)(position - 3) / (cacheSize - 3);
+                    result = std::pow(scale, 1.5f);
+                }
+            }
+
+            //  boost vertices with few triangles left, to finish them off and avoid isolated leftovers
+            return result + 2.0f / std::sqrt((float)remaining[vertex]);
+        };
+
+        for (size_t v = 0; v < vertexCount; v++) vertexScore[v] = score((uint32_t)v);
+
+        for (size_t t = 0; t < numTriangles; t++) {
+            for (int k = 0; k < 3; k++) triangleScore[t] += vertexScore[indices[t * 3 + k]];
+        }
+
+        std::vector<uint32_t> cache;
+        std::vector<uint32_t> result;
+        result.reserve(indices.size());
+
+        //  the next cache state, reused across triangles (swapped with `cache` below)
+        std::vector<uint32_t> newCache;
+        newCache.reserve(cacheSize + 3);
+        cache.reserve(cacheSize + 3);
+
+        size_t scanCursor = 0;
+        long best = -1;
+
+        for (size_t emittedCount = 0; emittedCount < numTriangles; emittedCount++) {
+
+            //  nothing promising in the cache, fall back to the next unemitted triangle
+            if (best < 0) {
+                while (emitted[scanCursor]) scanCursor++;
+                best = (long)scanCursor;
+            }
+
+            uint32_t triangle = (uint32_t)best;
+            emitted[triangle] = true;
+
+            //  emit, remove the triangle from its vertices' adjacency and put them at the front of the cache
+            newCache.clear();
+
+            for (int k = 0; k < 3; k++) {
+
+                uint32_t vertex = indices[triangle * 3 + k];
+                result.push_back(vertex);
+
+                uint32_t* begin = &adjacency[offsets[vertex]];
+                uint32_t* end = begin + remaining[vertex];
+                uint32_t* found = std::find(begin, end, triangle);
+                std::swap(*found, *(end - 1));
+                remaining[vertex]--;
+
+                newCache.push_back(vertex);
+            }
+
+            for (size_t i = 0; i < cache.size(); i++) {
+                if (cache[i] != newCache[0] && cache[i] != newCache[1] && cache[i] != newCache[2]) {
+                    newCache.push_back(cache[i]);
+                }
+            }
+
+            //  vertices pushed out of the cache lose their cache score
+            for (size_t i = cacheSize; i < newCache.size(); i++) {
+
+                uint32_t vertex = newCache[i];
+                cachePosition[vertex] = -1;
+
+                float newScore = score(vertex);
+                float delta = newScore - vertexScore[vertex];
+                vertexScore[vertex] = newScore;
+
+                for (uint32_t a = offsets[vertex]; a < offsets[vertex] + remaining[vertex]; a++) {
+                    triangleScore[adjacency[a]] += delta;
+                }
+            }
+
+            if (newCache.size() > (size_t)cacheSize) newCache.resize(cacheSize);
+            cache.swap(newCache);
+
+            //  rescore everything in the cache and pick the best triangle touching it
+            best = -1;
+            float bestScore = -1.0f;
+
+            for (size_t i = 0; i < cache.size(); i++) {
+
+                uint32_t vertex = cache[i];
+                cachePosition[vertex] = (int)i;
+
+                float newScore = score(vertex);
+                float delta = newScore - vertexScore[vertex];
+                vertexScore[vertex] = newScore;
+
+                for (uint32_t a = offsets[vertex]; a < offsets[vertex] + remaining[vertex]; a++) {
+                    triangleScore[adjacency[a]] += delta;
+                }
+            }
+
+            for (size_t i = 0; i < cache.size(); i++) {
+
+                uint32_t vertex = cache[i];
+
+                for (uint32_t a = offsets[vertex]; a < offsets[vertex] + remaining[vertex]; a++) {
+                    uint32_t candidate = adjacency[a];
+                    if (triangleScore[candidate] > bestScore) {
+                        bestScore = triangleScore[candidate];
+                        best = (long)candidate;
+                    }
+                }
+            }
+        }
+
+        indices.swap(result);
+    }
+
+    //  Reorder clusters of a cache-optimized index buffer to reduce overdraw.
+    //  A cluster ends wherever the cache simulation shows a triangle whose three
+    //  vertices all miss, i.e. where the cache-friendly order restarts anyway, so
+    //  moving clusters around costs little cache efficiency. `threshold` bounds
+    //  that cost: clusters are merged until the ACMR would exceed threshold times the original
+    inline void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<float>& vertices, int vertexStride, float threshold = 1.05f) {
+
+        size_t numTriangles = indices.size() / 3;
+        size_t vertexCount = vertices.size() / vertexStride;
+        if (numTriangles < 2) return;
+
+        //  hard boundaries
+        const size_t cacheSize = 16;
+        std::vector<size_t> cachedAt(vertexCount, 0);
+        size_t timestamp = cacheSize + 1;
+        std::vector<size_t> starts;
+
+        for (size_t t = 0; t < numTriangles; t++) {
+
+            int misses = 0;
+            for (int k = 0; k < 3; k++) {
+                uint32_t vertex = indices[t * 3 + k];
+                if (timestamp - cachedAt[vertex] > cacheSize) {
+                    cachedAt[vertex] = timestamp++;
+                    misses++;
+                }
+            }
+
+            if (t == 0 || misses == 3) starts.push_back(t);
+        }
+
+        //  merge tiny clusters: each cluster must contain enough triangles for the
+        //  extra misses at its start to stay within the threshold
+        double baseAcmr = analyzeVertexCache(indices, vertexCount, cacheSize).acmr;
+        size_t minTriangles = (size_t)std::ceil(3.0 / std::max(1e-3, baseAcmr * (threshold - 1.0)));
+
+        std::vector<size_t> clusters;
+        for (size_t i = 0; i < starts.size(); i++) {
+            if (clusters.empty() || starts[i] - clusters.back() >= minTriangles) clusters.push_back(starts[i]);
+        }
+        clusters.push_back(numTriangles);
+
+        //  sort key: how much the cluster faces away from the mesh centre
+        float meshCentre[3] = {0.0f, 0.0f, 0.0f};
+        for (size_t v = 0; v < vertexCount; v++) {
+            for (int c = 0; c < 3; c++) meshCentre[c] += vertices[v * vertexStride + c] / vertexCount;
+        }
+
+        struct Cluster {
+            size_t begin, end;
+            float key;
+        };
+
+        std::vector<Cluster> sorted;
+
+        for (size_t i = 0; i + 1 < clusters.size(); i++) {
+
+            Cluster cluster;
+            cluster.begin = clusters[i];
+            cluster.end = clusters[i + 1];
+
+            float centroid[3] = {0.0f, 0.0f, 0.0f};
+            float normal[3] = {0.0f, 0.0f, 0.0f};
+            float area = 0.0f;
+
+            for (size_t t = cluster.begin; t < cluster.end; t++) {
+
+                const float* a = &vertices[indices[t * 3 + 0] * vertexStride];
+                const float* b = &vertices[indices[t * 3 + 1] * vertexStride];
+                const float* c = &vertices[indices[t * 3 + 2] * vertexStride];
+
+                float e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+                float e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+                float n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+                float triangleArea = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+                //  area weighted, the normal's length already is twice the area
+                for (int k = 0; k < 3; k++) {
+                    centroid[k] += (a[k] + b[k] + c[k]) / 3.0f * triangleArea;
+                    normal[k] += n[k];
+                }
+                area += triangleArea;
+            }
+
+            float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            cluster.key = 0.0f;
+
+            if (area > 0.0f && length > 0.0f) {
+                for (int k = 0; k < 3; k++) {
+                    cluster.key += (centroid[k] / area - meshCentre[k]) * normal[k] / length;
+                }
+            }
+
+            sorted.push_back(cluster);
+        }
+
+        std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) {
+            return a.key > b.key;
+        });
+
+        std::vector<uint32_t> result;
+        result.reserve(indices.size());
+
+        for (size_t i = 0; i < sorted.size(); i++) {
+            result.insert(result.end(), indices.begin() + sorted[i].begin * 3, indices.begin() + sorted[i].end * 3);
+        }
+
+        indices.swap(result);
+    }
+
+    //  Store vertices in the order they are first referenced so fetching them
+    //  walks memory linearly, and remap the indices accordingly
+    inline void optimizeVertexFetch(std::vector<float>& vertices, std::vector<uint32_t>& indices, int vertexStride) {
+
+        size_t vertexCount = vertices.size() / vertexStride;
+        const uint32_t unused = 0xFFFFFFFFu;
+
+        std::vector<uint32_t> remap(vertexCount, unused);
+        std::vector<float> result;
+        result.reserve(vertices.size());
+
+        uint32_t next = 0;
+
+        for (size_t i = 0; i < indices.size(); i++) {
+
+            uint32_t vertex = indices[i];
+
+            if (remap[vertex] == unused) {
+                remap[vertex] = next++;
+                result.insert(result.end(), vertices.begin() + vertex * vertexStride, vertices.begin() + (vertex + 1) * vertexStride);
+            }
+
+            indices[i] = remap[vertex];
+        }
+
+        //  vertices no triangle uses are dropped
+        vertices.swap(result);
+    }
+
+}
+
+//  Run all passes on `mesh` and print the cache metrics before and after
+inline void optimizeMesh(Mesh& mesh, const std::string& name) {
+
+    MeshOptimizer::CacheStats before = MeshOptimizer::analyzeVertexCache(mesh.indices, mesh.vertexCount());
+
+    MeshOptimizer::optimizeVertexCache(mesh.indices, mesh.vertexCount());
+    MeshOptimizer::optimizeOverdraw(mesh.indices, mesh.vertices, mesh.vertexStride);
+    MeshOptimizer::optimizeVertexFetch(mesh.vertices, mesh.indices, mesh.vertexStride);
+
+    MeshOptimizer::CacheStats after = MeshOptimizer::analyzeVertexCache(mesh.indices, mesh.vertexCount());
+
+    std::printf("mesh %s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+        name.c_str(), before.acmr, after.acmr, before.atvr, after.atvr);
+}
+
+#endif
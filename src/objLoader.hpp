@@ -0,0 +1,842 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include "glad/glad.h"
+#include "mesh.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//  Read-only view of a whole file, mapped instead of read so parsing works on
+//  the page cache directly and threads can start anywhere in the file
+class MappedFile {
+
+public:
+
+    MappedFile(const std::string& path) {
+
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open " + path);
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            close(fd);
+            throw std::runtime_error("Failed to stat " + path);
+        }
+
+        length = (size_t)info.st_size;
+
+        //  mmap refuses empty mappings, an empty file is simply no data
+        if (length > 0) {
+
+            void* mapped = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                close(fd);
+                throw std::runtime_error("Failed to map " + path);
+            }
+
+            bytes = (const char*)mapped;
+            madvise(mapped, length, MADV_WILLNEED);
+        }
+
+        close(fd);
+    }
+
+    ~MappedFile() {
+        if (bytes) munmap((void*)bytes, length);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const {
+        return bytes;
+    }
+
+    size_t size() const {
+        return length;
+    }
+
+private:
+
+    const char* bytes = NULL;
+    size_t length = 0;
+
+};
+
+//  Wavefront OBJ to an indexed Mesh in PositionColorLayout, ready for
+//  GraphicsPipeline::loadMesh. The file is mapped and cut into chunks that end on
+//  a line break; every thread claims chunks and parses them into chunk-local
+//  arrays, so the parse needs no locks. Prefix sums over the chunk counts then
+//  give each chunk its place in the merged arrays, and faces referring back with
+//  negative indices are resolved against them in a second parallel pass.
+//
+//  `v` (with optional vertex colors), `vn` and `f` (any polygon, fan-triangulated)
+//  are read, everything else (`vt`, `o`, `g`, `usemtl`, ...) is skipped: the
+//  layout has no texture coordinates. The color of a vertex is its vertex color,
+//  else its normal mapped to [0, 1], else its position within the bounds.
+//
+//      ObjLoader loader;
+//      Mesh mesh = loader.load("bunny.obj");
+//      loader.report("bunny.obj");
+//      pipeline.loadMesh(mesh);
+class ObjLoader {
+
+public:
+
+    //  Time spent in each step of the last load, in milliseconds
+    struct Timings {
+        double map = 0.0;
+        double parse = 0.0;
+        double merge = 0.0;
+        double index = 0.0;
+
+        double total() const {
+            return map + parse + merge + index;
+        }
+    };
+
+    //  threads parsing, the caller included
+    unsigned int threads = defaultThreads();
+
+    //  center the mesh and scale it into [-fitExtent, fitExtent], e.g. to draw it
+    //  with a shader that has no projection
+    bool fitToView = false;
+    float fitExtent = 0.9f;
+
+    //  what the last load read
+    Timings timings;
+    size_t bytes = 0;
+    size_t lines = 0;
+    size_t positions = 0;
+    size_t normals = 0;
+    size_t triangles = 0;
+
+    Mesh load(const std::string& path) {
+
+        timings = Timings();
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        MappedFile file(path);
+        timings.map = elapsedSince(start);
+
+        Mesh mesh = parseText(file.data(), file.size());
+
+        if (mesh.indices.empty()) {
+            throw std::runtime_error("ObjLoader: no triangles in " + path);
+        }
+
+        return mesh;
+    }
+
+    //  Same as `load` for OBJ text already in memory
+    Mesh parse(const char* data, size_t size) {
+
+        timings = Timings();
+        return parseText(data, size);
+    }
+
+    void report(const std::string& name) const {
+
+        double megabytes = bytes / (1024.0 * 1024.0);
+        double total = timings.total();
+
+        std::printf("obj %s: %.1f MB, %zu lines in %.1f ms (%.0f MB/s, %u threads): %zu positions, %zu normals, %zu triangles\n",
+            name.c_str(), megabytes, lines, total, total > 0.0 ? megabytes * 1000.0 / total : 0.0, threads,
+            positions, normals, triangles);
+        std::printf("obj %s: map %.1f ms, parse %.1f ms, merge %.1f ms, index %.1f ms\n",
+            name.c_str(), timings.map, timings.parse, timings.merge, timings.index);
+    }
+
+    //  Parse a decimal float at `cursor`, stopping at `end`. Returns where the
+    //  number ended, or `cursor` when there is none.
+    //  Up to 19 significant digits and a power of ten within 1e22 (all the
+    //  numbers OBJ exporters write) take Clinger's fast path: mantissa and power
+    //  are both exact doubles, so one multiply or divide gives the correctly
+    //  rounded double, which is then rounded to float. Anything else goes
+    //  through strtod
+    static const char* parseFloat(const char* cursor, const char* end, float& value) {
+
+        static const double powersOfTen[] = {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+
+        const char* p = cursor;
+        bool negative = false;
+
+        if (p < end && (*p == '-' || *p == '+')) {
+            negative = *p == '-';
+            p++;
+        }
+
+        uint64_t mantissa = 0;
+        int significant = 0;
+        int exponent = 0;
+        bool digits = false;
+        bool truncated = false;
+
+        for (; p < end && isDigit(*p); p++) {
+            digits = true;
+            if (significant < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa != 0) significant++;
+            } else {
+                exponent++;
+                truncated = true;
+            }
+        }
+
+        if (p < end && *p == '.') {
+            for (p++; p < end && isDigit(*p); p++) {
+                digits = true;
+                if (significant < 19) {
+                    mantissa = mantissa * 10 + (*p - '0');
+                    if (mantissa != 0) significant++;
+                    exponent--;
+                } else {
+                    truncated = true;
+                }
+            }
+        }
+
+        //  inf, nan, hex floats
+        if (!digits) return parseFloatSlow(cursor, end, value);
+
+        if (p < end && (*p == 'e' || *p == 'E')) {
+
+            const char* e = p + 1;
+            bool negativeExponent = false;
+
+            if (e < end && (*e == '-' || *e == '+')) {
+                negativeExponent = *e == '-';
+                e++;
+            }
+
+            //  only an exponent with digits belongs to the number
+            if (e < end && isDigit(*e)) {
+
+                int power = 0;
+                for (; e < end && isDigit(*e); e++) {
+                    if (power < 100000) power = power * 10 + (*e - '0');
+                }
+
+                exponent += negativeExponent ? -power : power;
+                p = e;
+            }
+        }
+
+        if (mantissa == 0) {
+            value = negative ? -0.0f : 0.0f;
+            return p;
+        }
+
+        if (truncated || mantissa > (1ull << 53) || exponent < -22 || exponent > 22) {
+            return parseFloatSlow(cursor, end, value);
+        }
+
+        double result = (double)mantissa;
+        result = exponent < 0 ? result / powersOfTen[-exponent] : result * powersOfTen[exponent];
+
+        value = (float)(negative ? -result : result);
+        return p;
+    }
+
+    static unsigned int defaultThreads() {
+
+        unsigned int cores = std::thread::hardware_concurrency();
+        return cores > 0 ? cores : 1;
+    }
+
+private:
+
+    Mesh parseText(const char* data, size_t size) {
+
+        bytes = size;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::vector<Chunk> chunks = split(data, size);
+
+        parallelFor(chunks.size(), [&](size_t i) {
+            parseChunk(chunks[i]);
+        });
+
+        timings.parse = elapsedSince(start);
+        start = std::chrono::steady_clock::now();
+
+        Merged merged = merge(chunks);
+
+        timings.merge = elapsedSince(start);
+        start = std::chrono::steady_clock::now();
+
+        Mesh mesh = buildMesh(merged);
+
+        timings.index = elapsedSince(start);
+        return mesh;
+    }
+
+    //  Face corners keep OBJ indices until the chunk's place in the merged arrays
+    //  is known. Non-negative values are already 0-based global indices; negative
+    //  (relative) OBJ indices are stored as the index counted from the chunk's own
+    //  first element, minus `relativeBias`, and `none` marks a missing normal
+    static constexpr int32_t relativeBias = 1 << 30;
+    static constexpr int32_t none = INT32_MIN;
+
+    struct Corner {
+        int32_t position;
+        int32_t normal;
+    };
+
+    //  A line-aligned piece of the file and everything parsed from it
+    struct Chunk {
+        const char* begin = NULL;
+        const char* end = NULL;
+
+        std::vector<float> positions;       //  xyz
+        std::vector<float> colors;          //  rgb, empty unless some `v` line has colors
+        std::vector<float> normals;         //  xyz
+        std::vector<Corner> corners;        //  3 per triangle
+
+        float boundsMin[3] = {INFINITY, INFINITY, INFINITY};
+        float boundsMax[3] = {-INFINITY, -INFINITY, -INFINITY};
+        size_t lines = 0;
+        bool cornerNormals = false;
+
+        //  where the chunk's data starts in the merged arrays
+        size_t positionBase = 0;
+        size_t normalBase = 0;
+        size_t cornerBase = 0;
+    };
+
+    //  All chunks' data in file order, corner indices resolved
+    struct Merged {
+        std::vector<float> positions;
+        std::vector<float> colors;
+        std::vector<float> normals;
+        std::vector<uint32_t> cornerPositions;
+        std::vector<uint32_t> cornerNormals;    //  ~0 for no normal, empty when no face has one
+        float boundsMin[3] = {INFINITY, INFINITY, INFINITY};
+        float boundsMax[3] = {-INFINITY, -INFINITY, -INFINITY};
+    };
+
+    static bool isDigit(char c) {
+        return c >= '0' && c <= '9';
+    }
+
+    static bool isBlank(char c) {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    static const char* skipBlanks(const char* p, const char* end) {
+        while (p < end && isBlank(*p)) p++;
+        return p;
+    }
+
+    static const char* parseFloatSlow(const char* cursor, const char* end, float& value) {
+
+        char token[64];
+        size_t length = 0;
+
+        while (cursor + length < end && length < sizeof(token) - 1 && !isBlank(cursor[length]) && cursor[length] != '\n') {
+            token[length] = cursor[length];
+            length++;
+        }
+
+        token[length] = '\0';
+
+        char* stop = NULL;
+        value = std::strtof(token, &stop);
+        return cursor + (stop - token);
+    }
+
+    static const char* parseIndex(const char* p, const char* end, long& index) {
+
+        bool negative = p < end && *p == '-';
+        if (negative) p++;
+
+        long value = 0;
+        for (; p < end && isDigit(*p); p++) {
+            if (value < (1l << 40)) value = value * 10 + (*p - '0');
+        }
+
+        index = negative ? -value : value;
+        return p;
+    }
+
+    //  About four chunks per thread so a slow chunk does not leave the others idle,
+    //  but no smaller than 1 MB so per-chunk overhead stays negligible
+    std::vector<Chunk> split(const char* data, size_t size) const {
+
+        const size_t minChunk = 1 << 20;
+        size_t count = std::max<size_t>(1, std::min<size_t>((size_t)threads * 4, size / minChunk));
+
+        std::vector<Chunk> chunks;
+        chunks.reserve(count);
+
+        const char* begin = data;
+        const char* end = data + size;
+
+        for (size_t i = 1; i <= count && begin < end; i++) {
+
+            const char* cut = i == count ? end : data + size * i / count;
+
+            if (cut < begin) cut = begin;
+
+            //  move the cut past the next line break so no line is split
+            if (cut < end) {
+                const char* newline = (const char*)std::memchr(cut, '\n', end - cut);
+                cut = newline ? newline + 1 : end;
+            }
+
+            if (cut == begin) continue;
+
+            Chunk chunk;
+            chunk.begin = begin;
+            chunk.end = cut;
+            chunks.push_back(std::move(chunk));
+            begin = cut;
+        }
+
+        return chunks;
+    }
+
+    static void parseChunk(Chunk& chunk) {
+
+        const char* p = chunk.begin;
+        const char* end = chunk.end;
+
+        while (p < end) {
+
+            const char* lineEnd = (const char*)std::memchr(p, '\n', end - p);
+            if (!lineEnd) lineEnd = end;
+
+            p = skipBlanks(p, lineEnd);
+
+            if (lineEnd - p >= 2 && p[0] == 'v' && isBlank(p[1])) {
+                parseVertex(chunk, p + 2, lineEnd);
+            } else if (lineEnd - p >= 3 && p[0] == 'v' && p[1] == 'n' && isBlank(p[2])) {
+                parseNormal(chunk, p + 3, lineEnd);
+            } else if (lineEnd - p >= 2 && p[0] == 'f' && isBlank(p[1])) {
+                parseFace(chunk, p + 2, lineEnd);
+            }
+
+            chunk.lines++;
+            p = lineEnd + 1;
+        }
+    }
+
+    //  Reads up to `count` floats, returns how many there were
+    static int parseFloats(const char* p, const char* end, float* values, int count) {
+
+        int read = 0;
+
+        while (read < count) {
+
+            p = skipBlanks(p, end);
+            if (p == end) break;
+
+            const char* next = parseFloat(p, end, values[read]);
+            if (next == p) {
+                throw std::runtime_error("ObjLoader: malformed number in \"" + std::string(p, end) + "\"");
+            }
+
+            p = next;
+            read++;
+        }
+
+        return read;
+    }
+
+    //  `v x y z`, `v x y z w` or `v x y z r g b`
+    static void parseVertex(Chunk& chunk, const char* p, const char* end) {
+
+        float values[6];
+        int count = parseFloats(p, end, values, 6);
+
+        if (count < 3) {
+            throw std::runtime_error("ObjLoader: vertex with fewer than 3 coordinates");
+        }
+
+        for (int axis = 0; axis < 3; axis++) {
+            chunk.boundsMin[axis] = std::min(chunk.boundsMin[axis], values[axis]);
+            chunk.boundsMax[axis] = std::max(chunk.boundsMax[axis], values[axis]);
+        }
+
+        chunk.positions.insert(chunk.positions.end(), values, values + 3);
+
+        if (count == 6) {
+            //  vertices before the first colored one default to white
+            chunk.colors.resize(chunk.positions.size() - 3, 1.0f);
+            chunk.colors.insert(chunk.colors.end(), values + 3, values + 6);
+        } else if (!chunk.colors.empty()) {
+            chunk.colors.insert(chunk.colors.end(), 3, 1.0f);
+        }
+    }
+
+    static void parseNormal(Chunk& chunk, const char* p, const char* end) {
+
+        float values[3];
+
+        if (parseFloats(p, end, values, 3) != 3) {
+            throw std::runtime_error("ObjLoader: normal without 3 coordinates");
+        }
+
+        chunk.normals.insert(chunk.normals.end(), values, values + 3);
+    }
+
+    //  Turn an OBJ index (1-based, or negative counting back from the newest
+    //  element) into the encoding of `Corner`, `count` elements in the chunk so far
+    static int32_t encodeIndex(long index, size_t count) {
+
+        if (index > 0) {
+            if (index > relativeBias) throw std::runtime_error("ObjLoader: index too large");
+            return (int32_t)(index - 1);
+        }
+
+        if (index == 0) throw std::runtime_error("ObjLoader: index 0 in face");
+
+        long local = (long)count + index;
+        if (local <= -relativeBias) throw std::runtime_error("ObjLoader: relative index too large");
+
+        return (int32_t)(local - relativeBias);
+    }
+
+    //  `f v v v ...` with every corner `v`, `v/vt`, `v//vn` or `v/vt/vn`,
+    //  polygons split into a fan of triangles around the first corner
+    static void parseFace(Chunk& chunk, const char* p, const char* end) {
+
+        size_t localPositions = chunk.positions.size() / 3;
+        size_t localNormals = chunk.normals.size() / 3;
+
+        Corner first = {none, none};
+        Corner previous = {none, none};
+        int corners = 0;
+
+        while (true) {
+
+            p = skipBlanks(p, end);
+            if (p == end) break;
+
+            long index;
+            const char* next = parseIndex(p, end, index);
+            if (next == p || (next == p + 1 && *p == '-')) {
+                throw std::runtime_error("ObjLoader: malformed face \"" + std::string(p, end) + "\"");
+            }
+
+            p = next;
+
+            Corner corner;
+            corner.position = encodeIndex(index, localPositions);
+            corner.normal = none;
+
+            if (p < end && *p == '/') {
+
+                //  the texture coordinate, if any, is skipped
+                p++;
+                while (p < end && (isDigit(*p) || *p == '-')) p++;
+
+                if (p < end && *p == '/') {
+                    p++;
+                    next = parseIndex(p, end, index);
+                    if (next != p) {
+                        corner.normal = encodeIndex(index, localNormals);
+                        chunk.cornerNormals = true;
+                    }
+                    p = next;
+                }
+            }
+
+            if (corners == 0) {
+                first = corner;
+            } else if (corners >= 2) {
+                chunk.corners.push_back(first);
+                chunk.corners.push_back(previous);
+                chunk.corners.push_back(corner);
+            }
+
+            previous = corner;
+            corners++;
+        }
+    }
+
+    static uint32_t resolve(int32_t index, size_t base, size_t count) {
+
+        size_t resolved = index >= 0 ? (size_t)index : base + (size_t)((long)index + relativeBias);
+
+        //  a relative index reaching before the file start wraps around and is caught here too
+        if (resolved >= count) {
+            throw std::runtime_error("ObjLoader: face refers to an element that does not exist");
+        }
+
+        return (uint32_t)resolved;
+    }
+
+    Merged merge(std::vector<Chunk>& chunks) {
+
+        size_t totalPositions = 0, totalNormals = 0, totalCorners = 0;
+        bool colors = false, cornerNormals = false;
+
+        lines = 0;
+
+        for (Chunk& chunk : chunks) {
+
+            chunk.positionBase = totalPositions;
+            chunk.normalBase = totalNormals;
+            chunk.cornerBase = totalCorners;
+
+            totalPositions += chunk.positions.size() / 3;
+            totalNormals += chunk.normals.size() / 3;
+            totalCorners += chunk.corners.size();
+            lines += chunk.lines;
+
+            colors = colors || !chunk.colors.empty();
+            cornerNormals = cornerNormals || chunk.cornerNormals;
+        }
+
+        Merged merged;
+
+        for (const Chunk& chunk : chunks) {
+            for (int axis = 0; axis < 3; axis++) {
+                merged.boundsMin[axis] = std::min(merged.boundsMin[axis], chunk.boundsMin[axis]);
+                merged.boundsMax[axis] = std::max(merged.boundsMax[axis], chunk.boundsMax[axis]);
+            }
+        }
+
+        if (totalPositions > UINT32_MAX || totalCorners > UINT32_MAX) {
+            throw std::runtime_error("ObjLoader: mesh too large for 32 bit indices");
+        }
+
+        positions = totalPositions;
+        normals = totalNormals;
+        triangles = totalCorners / 3;
+
+        merged.positions.resize(totalPositions * 3);
+        merged.normals.resize(totalNormals * 3);
+        merged.cornerPositions.resize(totalCorners);
+
+        //  a face normal can only point at a normal that exists
+        if (cornerNormals && totalNormals == 0) {
+            throw std::runtime_error("ObjLoader: face refers to a normal but the file has none");
+        }
+
+        if (colors) merged.colors.resize(totalPositions * 3);
+        if (cornerNormals) merged.cornerNormals.resize(totalCorners);
+
+        parallelFor(chunks.size(), [&](size_t i) {
+
+            Chunk& chunk = chunks[i];
+
+            std::copy(chunk.positions.begin(), chunk.positions.end(), merged.positions.begin() + chunk.positionBase * 3);
+            std::copy(chunk.normals.begin(), chunk.normals.end(), merged.normals.begin() + chunk.normalBase * 3);
+
+            if (colors) {
+                std::vector<float>::iterator target = merged.colors.begin() + chunk.positionBase * 3;
+                std::copy(chunk.colors.begin(), chunk.colors.end(), target);
+                std::fill(target + chunk.colors.size(), target + chunk.positions.size(), 1.0f);
+            }
+
+            for (size_t c = 0; c < chunk.corners.size(); c++) {
+
+                const Corner& corner = chunk.corners[c];
+                merged.cornerPositions[chunk.cornerBase + c] = resolve(corner.position, chunk.positionBase, totalPositions);
+
+                if (cornerNormals) {
+                    merged.cornerNormals[chunk.cornerBase + c] = corner.normal == none
+                        ? ~0u : resolve(corner.normal, chunk.normalBase, totalNormals);
+                }
+            }
+
+            //  the chunk's own arrays are not needed any more
+            chunk = Chunk();
+        });
+
+        return merged;
+    }
+
+    //  A vertex is a (position, normal) pair. Usually each position is used with a
+    //  single normal (or none), and then the vertices are simply the positions and
+    //  the face indices are the position indices. Otherwise the distinct pairs
+    //  are welded through a hash table
+    Mesh buildMesh(Merged& merged) {
+
+        Mesh mesh;
+        mesh.vertexStride = 6;
+
+        size_t numPositions = merged.positions.size() / 3;
+        size_t numCorners = merged.cornerPositions.size();
+
+        //  position and normal index of every output vertex
+        std::vector<uint32_t> vertexNormals;
+        std::vector<uint32_t> vertexPositions;
+        bool byPosition = true;
+
+        if (!merged.cornerNormals.empty()) {
+
+            vertexNormals.assign(numPositions, ~0u);
+
+            for (size_t c = 0; c < numCorners && byPosition; c++) {
+
+                uint32_t& normal = vertexNormals[merged.cornerPositions[c]];
+
+                if (normal == ~0u) {
+                    normal = merged.cornerNormals[c];
+                } else if (normal != merged.cornerNormals[c]) {
+                    byPosition = false;
+                }
+            }
+        }
+
+        if (byPosition) {
+            mesh.indices.swap(merged.cornerPositions);
+        } else {
+            weld(merged, mesh.indices, vertexPositions, vertexNormals);
+        }
+
+        size_t numVertices = byPosition ? numPositions : vertexPositions.size();
+        mesh.vertices.resize(numVertices * 6);
+
+        float center[3], extent[3], scale = 1.0f, largest = 0.0f;
+        for (int axis = 0; axis < 3; axis++) {
+            center[axis] = (merged.boundsMin[axis] + merged.boundsMax[axis]) * 0.5f;
+            extent[axis] = merged.boundsMax[axis] - merged.boundsMin[axis];
+            largest = std::max(largest, extent[axis]);
+        }
+
+        if (fitToView && largest > 0.0f) {
+            scale = 2.0f * fitExtent / largest;
+        }
+
+        //  fill the vertices in blocks, in parallel
+        const size_t block = 1 << 16;
+
+        parallelFor((numVertices + block - 1) / block, [&](size_t b) {
+
+            size_t last = std::min(numVertices, (b + 1) * block);
+
+            for (size_t v = b * block; v < last; v++) {
+
+                uint32_t position = byPosition ? (uint32_t)v : vertexPositions[v];
+                uint32_t normal = vertexNormals.empty() ? ~0u : vertexNormals[v];
+
+                const float* source = &merged.positions[position * 3];
+                float* target = &mesh.vertices[v * 6];
+
+                for (int axis = 0; axis < 3; axis++) {
+
+                    target[axis] = fitToView ? (source[axis] - center[axis]) * scale : source[axis];
+
+                    if (!merged.colors.empty()) {
+                        target[3 + axis] = merged.colors[position * 3 + axis];
+                    } else if (normal != ~0u) {
+                        target[3 + axis] = merged.normals[normal * 3 + axis] * 0.5f + 0.5f;
+                    } else {
+                        target[3 + axis] = extent[axis] > 0.0f ? (source[axis] - merged.boundsMin[axis]) / extent[axis] : 1.0f;
+                    }
+                }
+            }
+        });
+
+        mesh.indexType = numVertices <= 0xFFFF ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        return mesh;
+    }
+
+    //  Distinct (position, normal) pairs through an open-addressing table keyed by
+    //  both indices packed into 64 bits. Fills `vertexNormals` per output vertex
+    static void weld(const Merged& merged, std::vector<uint32_t>& indices,
+        std::vector<uint32_t>& vertexPositions, std::vector<uint32_t>& vertexNormals) {
+
+        size_t numCorners = merged.cornerPositions.size();
+
+        size_t capacity = 16;
+        while (capacity < numCorners + numCorners / 2) capacity *= 2;
+
+        const uint64_t empty = ~0ull;
+        std::vector<uint64_t> keys(capacity, empty);
+        std::vector<uint32_t> slots(capacity);
+
+        indices.resize(numCorners);
+        vertexPositions.clear();
+        vertexNormals.clear();
+
+        for (size_t c = 0; c < numCorners; c++) {
+
+            uint64_t key = (uint64_t)merged.cornerPositions[c] << 32 | merged.cornerNormals[c];
+
+            //  multiplicative hash, the high bits are the best mixed
+            size_t slot = (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & (capacity - 1);
+
+            while (keys[slot] != empty && keys[slot] != key) {
+                slot = (slot + 1) & (capacity - 1);
+            }
+
+            if (keys[slot] == empty) {
+                keys[slot] = key;
+                slots[slot] = (uint32_t)vertexPositions.size();
+                vertexPositions.push_back(merged.cornerPositions[c]);
+                vertexNormals.push_back(merged.cornerNormals[c]);
+            }
+
+            indices[c] = slots[slot];
+        }
+    }
+
+    //  Run `work(i)` for i in [0, count) on up to `threads` threads, the caller
+    //  included. The first exception thrown by any of them is rethrown here
+    void parallelFor(size_t count, const std::function<void(size_t)>& work) const {
+
+        std::atomic<size_t> next{0};
+        std::exception_ptr failure;
+        std::mutex mutex;
+
+        std::function<void()> loop = [&]() {
+
+            size_t i;
+            while ((i = next.fetch_add(1, std::memory_order_relaxed)) < count) {
+                try {
+                    work(i);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (!failure) failure = std::current_exception();
+                }
+            }
+        };
+
+        std::vector<std::thread> pool;
+        size_t extra = std::min<size_t>(threads, count);
+        for (size_t t = 1; t < extra; t++) pool.emplace_back(loop);
+
+        loop();
+
+        for (std::thread& thread : pool) {
+            thread.join();
+        }
+
+        if (failure) std::rethrow_exception(failure);
+    }
+
+    static double elapsedSince(std::chrono::steady_clock::time_point start) {
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count();
+    }
+
+};
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+//  Where frames are rendered to.
+//  `Window` opens a visible GLFW window, the headless backends create a
+//  context without any display and render into an offscreen framebuffer
+enum class Backend {
+    Window,
+    EGL,        //  EGL on Mesa's surfaceless platform (no X server, no GPU needed)
+    OSMesa      //  Mesa's off-screen software renderer
+};
+
+//  Settings picked on the command line and handed to the App on construction
+struct AppOptions {
+
+    Backend backend = Backend::Window;
+
+    //  number of frames to render before leaving the render loop, 0 keeps
+    //  rendering until the window is closed
+    unsigned int frames = 0;
+
+    //  when set, the last rendered frame is written to this file as a PPM image
+    std::string outputPath;
+
+    //  when set, run this benchmark (see benchmark.hpp) instead of the render loop
+    std::string benchmark;
+
+    //  filter redundant binds through GLStateCache (see glState.hpp)
+    bool stateCache = true;
+
+    //  time clear / draw / swap on the GPU and print a report at exit (see gpuProfiler.hpp)
+    bool gpuProfile = false;
+
+    //  when set, CPU zones are recorded and written to this file as a Chrome trace
+    std::string tracePath;
+
+    //  store vertices as half float positions and normalized byte colors
+    bool compactVertices = false;
+
+    //  keep linked programs on disk (see programCache.hpp), in `programCacheDir`
+    //  or the default cache directory when that is empty
+    bool programCache = true;
+    std::string programCacheDir;
+
+    //  submit shaders without waiting and finish them on first use
+    //  (GL_KHR_parallel_shader_compile where available)
+    bool asyncShaders = false;
+
+    //  when set, shaders are re-read from this directory whenever they change
+    //  on disk and swapped in between frames (see shaderWatcher.hpp)
+    std::string watchShadersDir;
+
+    //  only redraw when input, a resize or an animation needs it, sleeping in between
+    bool renderOnDemand = false;
+
+    //  glfwSwapInterval for the window, -1 keeps the driver's default
+    int swapInterval = 1;
+
+    //  frames per second the render loop is limited to, 0 for no limit
+    double fpsCap = 0.0;
+
+    //  when set, the frame time histogram is written to this file as CSV
+    std::string frameHistogramPath;
+
+    //  render on a thread of its own, the main thread only handles window events
+    bool renderThread = false;
+
+    //  when set, this Wavefront OBJ file is drawn instead of the triangle (see
+    //  objLoader.hpp). Also the model the `obj` benchmark loads
+    std::string meshPath;
+
+    int width = 700;
+    int height = 700;
+
+};
+
+inline Backend parseBackend(const char* name) {
+
+    if (std::strcmp(name, "window") == 0) return Backend::Window;
+    if (std::strcmp(name, "egl") == 0) return Backend::EGL;
+    if (std::strcmp(name, "osmesa") == 0) return Backend::OSMesa;
+
+    throw std::runtime_error(std::string("Unknown backend: ") + name);
+}
+
+//  Usage: opengl_project [--headless egl|osmesa] [--frames N] [--output frame.ppm]
+//                        [--bench instancing|streaming|shaders|uniforms|commands|sorting|pool|allocator|obj]
+//                        [--no-state-cache] [--gpu-profile]
+//                        [--trace trace.json] [--compact-vertices]
+//                        [--no-program-cache] [--program-cache dir] [--async-shaders]
+//                        [--watch-shaders dir] [--on-demand]
+//                        [--swap-interval N] [--fps-cap N] [--frame-histogram frames.csv]
+//                        [--render-thread] [--mesh model.obj]
+inline AppOptions parseOptions(int argc, char** argv) {
+
+    AppOptions options;
+
+    for (int i = 1; i < argc; i++) {
+
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--headless" && hasValue) {
+            options.backend = parseBackend(argv[++i]);
+        } else if (arg == "--frames" && hasValue) {
+            options.frames = std::strtoul(argv[++i], NULL, 10);
+        } else if (arg == "--output" && hasValue) {
+            options.outputPath = argv[++i];
+        } else if (arg == "--bench" && hasValue) {
+            options.benchmark = argv[++i];
+        } else if (arg == "--no-state-cache") {
+            options.stateCache = false;
+        } else if (arg == "--gpu-profile") {
+            options.gpuProfile = true;
+        } else if (arg == "--trace" && hasValue) {
+            options.tracePath = argv[++i];
+        } else if (arg == "--compact-vertices") {
+            options.compactVertices = true;
+        } else if (arg == "--no-program-cache") {
+            options.programCache = false;
+        } else if (arg == "--program-cache" && hasValue) {
+            options.programCacheDir = argv[++i];
+        } else if (arg == "--async-shaders") {
+            options.asyncShaders = true;
+        } else if (arg == "--watch-shaders" && hasValue) {
+            options.watchShadersDir = argv[++i];
+        } else if (arg == "--on-demand") {
+            options.renderOnDemand = true;
+        } else if (arg == "--swap-interval" && hasValue) {
+            options.swapInterval = std::atoi(argv[++i]);
+        } else if (arg == "--fps-cap" && hasValue) {
+            options.fpsCap = std::atof(argv[++i]);
+        } else if (arg == "--frame-histogram" && hasValue) {
+            options.frameHistogramPath = argv[++i];
+        } else if (arg == "--render-thread") {
+            options.renderThread = true;
+        } else if (arg == "--mesh" && hasValue) {
+            options.meshPath = argv[++i];
+        } else {
+            throw std::runtime_error("Unknown or incomplete option: " + arg);
+        }
+    }
+
+    //  a headless run has no window to close, so give it a finite amount of work
+    if (options.backend != Backend::Window && options.frames == 0) {
+        options.frames = 300;
+    }
+
+    return options;
+}
+
+#endif
@@ -1,8 +1,19 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
 #include "glad/glad.h"
 #include <GLFW/glfw3.h>
 #include <iostream>
 #include <cmath>
+#include <utility>
 #include <vector>
+#include "streamBuffer.hpp"
+#include "mesh.hpp"
+#include "meshOptimizer.hpp"
+#include "vertexFormat.hpp"
+#include "vertexLayout.hpp"
+#include "glResources.hpp"
+#include "objLoader.hpp"
 
 //  The graphics pipeline converts a set of 3D co-ordinates into
 //  2D pixels that fits in the screen
@@ -18,13 +29,35 @@ public:
     // unsigned int vertexShader;
     // unsigned int fragmentShader;
     // unsigned int shaderProgram;
-    unsigned int VBO;
-    unsigned int VAO;
-    unsigned int EBO;
+    //  owned through GLResources, `destroy` hands them back
+    BufferHandle VBO;
+    VertexArrayHandle VAO;
+    BufferHandle EBO;
+    BufferHandle instanceVBO;
+
+    //  set by `indexVertices`, `draw` then goes through the EBO
+    bool indexed = false;
+    GLenum indexType = GL_UNSIGNED_INT;
+    std::vector<unsigned char> indices;
+    uint32_t numIndices = 0;
+
+    //  vertices in the VBO, `draw` needs it once `handleVBO` released `vertices`
+    uint32_t numVertices = 0;
+
+    //  how `vertices` are quantized for the VBO. `compactVertices` switches to a
+    //  smaller format and fills `packedVertices` with the converted data; the
+    //  attributes themselves come from the matching compile-time VertexLayout
+    VertexFormat vertexFormat = VertexFormat::floatPositionColor();
+    std::vector<unsigned char> packedVertices;
+    bool compact = false;
+
+    //  number of floats per instance: transform (offset xyz, scale) and color (rgb)
+    static const int instanceStride = 7;
     
 
     //  vertices data for the triangle
     //  Vertex data is a collection of vertices
+    //  laid out as `PositionColorLayout`
     std::vector<float> vertices = {
 
         //  positions           //  colors
@@ -33,22 +66,67 @@ public:
         0.0f, 0.5f, 0.0f,       0.0f, 0.0f, 1.0f
     };
 
-    //  Unique Vertices for rectangle (to be used for EBO)
-    // float vertices[12] = {
-    //     0.5f, 0.5f, 0.0f,
-    //     0.5f, -0.5f, 0.0f,
-    //     -0.5f, -0.5f, 0.0f,
-    //     -0.5f, 0.5f, 0.0f
-    // };
+    //  Weld duplicate vertices of the triangle list in `vertices` and replace it
+    //  with the unique vertices, keeping the indices for the EBO.
+    //  For a rectangle the 6 vertices of its two triangles become 4 unique ones and
+    //  the indices 0, 1, 3, 1, 2, 3 (note that indices start from 0)
+    void indexVertices(const std::string& name = "triangle") {
+
+        size_t soupVertexCount = vertices.size() / 6;
+
+        Mesh mesh = buildIndexedMesh(vertices, 6);
+        reportMeshSavings(name, mesh, soupVertexCount);
+
+        //  reorder for the post-transform cache, overdraw and vertex fetch
+        optimizeMesh(mesh, name);
+        loadMesh(std::move(mesh));
+    }
+
+    //  Replace the triangle with a model from a Wavefront OBJ file, centered and
+    //  scaled to fit the view since the default shader has no projection
+    void loadObj(const std::string& path) {
+
+        std::string name = path.substr(path.find_last_of("/\\") + 1);
+
+        ObjLoader loader;
+        loader.fitToView = true;
+
+        Mesh mesh = loader.load(path);
+        loader.report(name);
+
+        optimizeMesh(mesh, name);
+        loadMesh(std::move(mesh));
+    }
+
+    //  Quantize the float vertices into half float positions and normalized byte
+    //  colors (`CompactPositionColorLayout`) to cut vertex bandwidth and VRAM.
+    //  Call before `handleVBO`
+    void compactVertices() {
+
+        VertexFormat format = VertexFormat::compactPositionColor();
+        size_t count = vertices.size() / 6;
+
+        packedVertices = Quantize::vertices(vertices, 6, format);
+        std::printf("vertex format: %u -> %u bytes per vertex, %zu -> %zu bytes\n",
+            vertexFormat.stride, format.stride, count * vertexFormat.stride, packedVertices.size());
+
+        vertexFormat = format;
+        compact = true;
+    }
+
+    //  Take vertices and indices from an already indexed mesh, the vertices are
+    //  moved out of it
+    void loadMesh(Mesh&& mesh) {
 
-    //  note that indices starts from 0 (to be used for EBO)
-    // unsigned int indices[6] = {
-    //     0, 1 , 3,
-    //     1, 2, 3
-    // };
+        vertices = std::move(mesh.vertices);
+        indices = mesh.packedIndices();
+        indexType = mesh.indexType;
+        numIndices = (uint32_t)mesh.indices.size();
+        indexed = true;
+    }
 
     void bindVAO() {
-        glBindVertexArray(VAO);
+        glBindVertexArray(GLResources::get(VAO));
     }
 
     //  Vertex buffer objects
@@ -59,44 +137,113 @@ public:
         bindVAO();
 
         //  Generate a buffer with an ID
-        glGenBuffers(1, &VBO);
+        VBO = GLResources::createBuffer();
 
         // std::cout << "VBO: " << VBO << std::endl;
 
         //  Bind buffer to the `GL_ARRAY_BUFFER`
         //  Buffer type for VBO is `GL_ARRAY_BUFFER`
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBindBuffer(GL_ARRAY_BUFFER, GLResources::get(VBO));
 
         //  copy the defined vertex into memory of the buffer currently binded, in 
-        //  this case, the VBO
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &vertices[0], GL_STATIC_DRAW);
+        //  this case, the VBO. An empty mesh leaves the buffer without storage
+        if (!packedVertices.empty()) {
+            glBufferData(GL_ARRAY_BUFFER, packedVertices.size(), packedVertices.data(), GL_STATIC_DRAW);
+        } else if (!vertices.empty()) {
+            glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+        }
+
+        //  the GPU has its copy, a large mesh should not stay in memory twice
+        numVertices = (uint32_t)(vertices.size() / 6);
+        std::vector<float>().swap(vertices);
+        std::vector<unsigned char>().swap(packedVertices);
 
     }
 
-    // void handleEBO() {
+    //  Element buffer objects
+    //  Stores the indices that decide which vertices make up each triangle,
+    //  so shared vertices are stored once in the VBO
+    void handleEBO() {
 
-    //     //  Generate buffer with an ID
-    //     glGenBuffers(1, &EBO);
+        //  the EBO binding is part of the VAO state
+        bindVAO();
+
+        //  Generate buffer with an ID
+        EBO = GLResources::createBuffer();
 
-    //     //  Bind EBO
-    //     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        //  Bind EBO
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, GLResources::get(EBO));
 
-    //     //  copy indices into the buffer
-    //     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+        //  copy indices into the buffer
+        if (!indices.empty()) {
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size(), indices.data(), GL_STATIC_DRAW);
+        }
 
-    // }
+        std::vector<unsigned char>().swap(indices);
+
+    }
+
+    //  Use a StreamBuffer instead of the static VBO, for geometry rewritten every frame.
+    //  Call before `setVertexAttribute` so the attributes point into the stream
+    void handleStreamVBO(StreamBuffer& stream, GLsizeiptr regionSize) {
+
+        bindVAO();
+        //  the stream owns its buffer, VBO stays null
+        stream.create(regionSize);
+
+    }
 
     //  Instruct OPENGL on how it should interpret the vertex data (per vertex attribute)
     //  using `glVertexAttribPointer`
     //  float size is 4 bytes, this represents the size of each position in a vertex
     //  The stride for a single 3D vertex will be 3 * 4 =  12. 
     //  A 3D vertex will have 12bytes by implication
+    //  The stride and offsets are computed from `PositionColorLayout` at compile time:
+    //  position is at offset 0 and color at offset 12 of a 24 byte vertex.
+    //  After `compactVertices` it is `CompactPositionColorLayout`, a 12 byte vertex
     void setVertexAttribute() {
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0); //    stride 24, offset 0
-        glEnableVertexAttribArray(0);       //  Enable the above attribute for the attribute at position 0 (position)
 
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*) (3 * sizeof(float))); //    stride 24, offset 12
-        glEnableVertexAttribArray(1);       //  Enable the above attribute for the attribute at position 1 (color)
+        if (!compact) {
+            setVertexAttribute<PositionColorLayout>();
+        } else {
+            setVertexAttribute<CompactPositionColorLayout>();
+        }
+
+    }
+
+    //  Attribute setup for any vertex type described by a `VertexLayout`
+    template <typename Layout>
+    void setVertexAttribute() {
+        Layout::apply();
+    }
+
+    //  Per-instance data lives in its own VBO. Each instance carries a transform
+    //  (vec4: offset xyz and a uniform scale in w) and a color (vec3), see shaders/instanced.vs
+    void handleInstanceVBO(const std::vector<float>& instanceData) {
+
+        bindVAO();
+
+        instanceVBO = GLResources::createBuffer();
+        glBindBuffer(GL_ARRAY_BUFFER, GLResources::get(instanceVBO));
+        if (!instanceData.empty()) {
+            glBufferData(GL_ARRAY_BUFFER, instanceData.size() * sizeof(float), instanceData.data(), GL_STATIC_DRAW);
+        }
+
+    }
+
+    //  Same as `setVertexAttribute` but for the instance VBO. The attribute divisor
+    //  of 1 makes OpenGL advance these attributes once per instance instead of once per vertex
+    void setInstanceAttribute() {
+
+        glBindBuffer(GL_ARRAY_BUFFER, GLResources::get(instanceVBO));
+
+        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, instanceStride * sizeof(float), (void*)0); //    stride 28, offset 0
+        glEnableVertexAttribArray(2);       //  transform
+        glVertexAttribDivisor(2, 1);
+
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, instanceStride * sizeof(float), (void*) (4 * sizeof(float))); //    stride 28, offset 16
+        glEnableVertexAttribArray(3);       //  color
+        glVertexAttribDivisor(3, 1);
 
     }
 
@@ -104,20 +251,54 @@ public:
     void generateVAO() {
 
         //  Generate VAO
-        glGenVertexArrays(1, &VAO);
+        VAO = GLResources::createVertexArray();
  
     }
 
-    void drawTriangle(uint32_t numOfVertices) {
-        glDrawArrays(GL_TRIANGLES, 0, numOfVertices); // for vertices
+    //  Hand the VAO and buffers back to GLResources, which deletes them once
+    //  the GPU has finished the frames that may still draw from them
+    void destroy() {
+
+        GLResources::destroy(VAO);
+        GLResources::destroy(VBO);
+        GLResources::destroy(EBO);
+        GLResources::destroy(instanceVBO);
+    }
+
+    //  `firstVertex` skips vertices at the start of the VBO, e.g. to draw from
+    //  the current region of a StreamBuffer
+    void drawTriangle(uint32_t numOfVertices, uint32_t firstVertex = 0) {
+        glDrawArrays(GL_TRIANGLES, firstVertex, numOfVertices); // for vertices
+
+    }
+
+    //  For EBO
+    //  First argument specifies the mode to draw in
+    //  Second: the total number of indices to draw
+    //  Third: The type of the indices (16 bit when the vertex count allows it)
+    //  Fourth: Offset in the EBO
+    void drawElements(uint32_t count) {
+        glDrawElements(GL_TRIANGLES, count, indexType, 0);
+    }
+
+    //  Draw the whole mesh, through the EBO when the vertices were indexed
+    void draw() {
+
+        if (indexed) {
+            drawElements(numIndices);
+        } else {
+            drawTriangle(numVertices);
+        }
 
-        //  For EBO
-        //  First argument specifies the mode to draw in
-        //  Second: the total number of vertices, since 6 indices were to be drawn
-        //  Third: The type of the indices
-        //  Fourth: Offset in the EBO
-        // glDrawElements(GL_TRIANGLES, numOfVertices, GL_UNSIGNED_INT, 0);
     }
 
+    //  Draw `count` copies of the mesh with a single draw call, each one picking
+    //  its transform and color from the instance VBO
+    void drawInstanced(uint32_t count, uint32_t numOfVertices = 3) {
+        glDrawArraysInstanced(GL_TRIANGLES, 0, numOfVertices, count);
+    }
+
+
+};
 
-};
\ No newline at end of file
+#endif
\ No newline at end of file
@@ -0,0 +1,268 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include "glad/glad.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <vector>
+
+//  On-disk cache of linked programs (GL_ARB_get_program_binary).
+//  A program is stored under a 64 bit key hashed from its shader sources and the
+//  GL_RENDERER / GL_VERSION strings, so a driver update or another GPU simply misses.
+//  The file also keeps the driver strings and the source lengths, so a hash
+//  collision between two programs is caught instead of loading the wrong binary.
+//  Warm starts load the driver's binary with glProgramBinary instead of compiling
+//  and linking GLSL; a binary the driver rejects is deleted and compiled again.
+//
+//      ProgramCache::Key key = ProgramCache::key(vertexSource, fragmentSource);
+//      if (!ProgramCache::load(key, program)) {
+//          ProgramCache::prepare(program);     //  before glLinkProgram
+//          ...compile and link...
+//          ProgramCache::store(key, program);
+//      }
+class ProgramCache {
+
+public:
+
+    //  Startup cost split by how each program was obtained
+    struct Counters {
+        unsigned int count;
+        double milliseconds;
+    };
+
+    inline static Counters hits = {0, 0.0};        //  warm: loaded from a binary
+    inline static Counters misses = {0, 0.0};      //  cold: compiled and linked from source
+
+    //  What a cached binary must match: the hash names the file, the lengths are
+    //  checked against the header on load
+    struct Key {
+        uint64_t hash;
+        uint32_t vertexLength;
+        uint32_t fragmentLength;
+    };
+
+    //  Turn the cache on when the context supports program binaries.
+    //  An empty `directory` picks $XDG_CACHE_HOME/opengl_project or ~/.cache/opengl_project
+    static void enable(const std::string& directory = "") {
+
+        if (!GLAD_GL_ARB_get_program_binary) {
+            std::printf("program cache: GL_ARB_get_program_binary not supported, compiling from source\n");
+            return;
+        }
+
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+
+        if (formats == 0) {
+            std::printf("program cache: driver offers no program binary formats, compiling from source\n");
+            return;
+        }
+
+        path = directory.empty() ? defaultDirectory() : directory;
+
+        std::error_code error;
+        std::filesystem::create_directories(path, error);
+
+        if (error) {
+            std::printf("program cache: cannot create %s (%s), compiling from source\n", path.c_str(), error.message().c_str());
+            return;
+        }
+
+        const char* renderer = (const char*)glGetString(GL_RENDERER);
+        const char* version = (const char*)glGetString(GL_VERSION);
+        driver = std::string(renderer ? renderer : "") + '\n' + (version ? version : "");
+
+        enabled = true;
+    }
+
+    static bool isEnabled() {
+        return enabled;
+    }
+
+    //  64 bit FNV-1a over the driver strings and every shader source
+    static Key key(const char* vertexSource, const char* fragmentSource) {
+
+        Key key;
+        key.hash = 14695981039346656037ull;
+        key.hash = fnv(key.hash, driver.c_str());
+        key.hash = fnv(key.hash, vertexSource);
+        key.hash = fnv(key.hash, fragmentSource);
+        key.vertexLength = (uint32_t)std::strlen(vertexSource);
+        key.fragmentLength = (uint32_t)std::strlen(fragmentSource);
+        return key;
+    }
+
+    //  Load the cached binary for `key` into `program` (from glCreateProgram).
+    //  Returns false when there is none or the driver refuses it
+    static bool load(const Key& key, unsigned int program) {
+
+        if (!enabled) return false;
+
+        std::string file = fileFor(key.hash);
+
+        //  a length past the end of the file is corrupt, do not allocate for it
+        std::error_code error;
+        uintmax_t fileSize = std::filesystem::file_size(file, error);
+        if (error) return false;
+
+        FILE* in = std::fopen(file.c_str(), "rb");
+        if (in == NULL) return false;
+
+        Header header;
+        std::string storedDriver;
+        std::vector<unsigned char> binary;
+        bool valid = std::fread(&header, sizeof(header), 1, in) == 1
+            && header.magic == magic && header.hash == key.hash
+            && header.vertexLength == key.vertexLength && header.fragmentLength == key.fragmentLength
+            && header.driverLength == driver.size()
+            && fileSize >= sizeof(header) + header.driverLength
+            && header.length > 0 && header.length <= fileSize - sizeof(header) - header.driverLength;
+
+        if (valid) {
+            storedDriver.resize(header.driverLength);
+            valid = std::fread(&storedDriver[0], 1, storedDriver.size(), in) == storedDriver.size()
+                && storedDriver == driver;
+        }
+
+        if (valid) {
+            binary.resize(header.length);
+            valid = std::fread(binary.data(), 1, binary.size(), in) == binary.size();
+        }
+
+        std::fclose(in);
+
+        if (valid) {
+            glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+
+            GLint linked = GL_FALSE;
+            glGetProgramiv(program, GL_LINK_STATUS, &linked);
+            valid = linked == GL_TRUE;
+        }
+
+        //  stale or corrupt, make room for a fresh binary
+        if (!valid) std::remove(file.c_str());
+
+        return valid;
+    }
+
+    //  Ask the driver to keep the binary retrievable, call before glLinkProgram
+    static void prepare(unsigned int program) {
+        if (enabled) glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    //  Write the binary of the linked `program` under `key`
+    static void store(const Key& key, unsigned int program) {
+
+        if (!enabled) return;
+
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0) return;
+
+        Header header;
+        header.magic = magic;
+        header.hash = key.hash;
+        header.vertexLength = key.vertexLength;
+        header.fragmentLength = key.fragmentLength;
+        header.driverLength = (uint32_t)driver.size();
+        header.length = (uint32_t)length;
+
+        std::vector<unsigned char> binary(length);
+        GLenum format = 0;
+        glGetProgramBinary(program, length, NULL, &format, binary.data());
+        header.format = format;
+
+        //  write to a temporary and rename, so a crash never leaves a torn binary behind
+        std::string file = fileFor(key.hash);
+        std::string temporary = file + ".tmp";
+        FILE* out = std::fopen(temporary.c_str(), "wb");
+        if (out == NULL) return;
+
+        bool written = std::fwrite(&header, sizeof(header), 1, out) == 1
+            && std::fwrite(driver.data(), 1, driver.size(), out) == driver.size()
+            && std::fwrite(binary.data(), 1, binary.size(), out) == binary.size();
+
+        if (std::fclose(out) == 0 && written) {
+            std::rename(temporary.c_str(), file.c_str());
+        } else {
+            std::remove(temporary.c_str());
+        }
+    }
+
+    static void record(bool hit, std::chrono::steady_clock::duration elapsed) {
+
+        Counters& counters = hit ? hits : misses;
+        counters.count++;
+        counters.milliseconds += std::chrono::duration<double, std::milli>(elapsed).count();
+    }
+
+    //  Print cold (compiled) vs warm (cached) program setup times
+    static void report() {
+
+        if (hits.count + misses.count == 0) return;
+
+        std::printf("program cache: %u warm (%.2f ms, %.2f ms/program), %u cold (%.2f ms, %.2f ms/program)%s\n",
+            hits.count, hits.milliseconds, hits.count ? hits.milliseconds / hits.count : 0.0,
+            misses.count, misses.milliseconds, misses.count ? misses.milliseconds / misses.count : 0.0,
+            enabled ? "" : ", cache disabled");
+    }
+
+private:
+
+    //  "GLP2", bump the digit when Header changes
+    static const uint32_t magic = 0x32504C47u;
+
+    //  followed by the driver strings (`driverLength` bytes) and the binary (`length` bytes)
+    struct Header {
+        uint32_t magic;
+        uint32_t format;        //  binaryFormat from glGetProgramBinary
+        uint64_t hash;          //  the file name, Key::hash
+        uint32_t vertexLength;  //  with `driverLength`, tells apart programs whose hashes collide
+        uint32_t fragmentLength;
+        uint32_t driverLength;
+        uint32_t length;
+    };
+
+    inline static bool enabled = false;
+    inline static std::string path;
+    inline static std::string driver;
+
+    static std::string defaultDirectory() {
+
+        const char* xdg = std::getenv("XDG_CACHE_HOME");
+        if (xdg && *xdg) return std::string(xdg) + "/opengl_project";
+
+        const char* home = std::getenv("HOME");
+        if (home && *home) return std::string(home) + "/.cache/opengl_project";
+
+        return ".program_cache";
+    }
+
+    static std::string fileFor(uint64_t key) {
+
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+        return path + "/" + name;
+    }
+
+    //  the terminating 0 is hashed too, so ("ab", "c") and ("a", "bc") differ
+    static uint64_t fnv(uint64_t hash, const char* text) {
+
+        for (const char* c = text; ; c++) {
+            hash ^= (unsigned char)*c;
+            hash *= 1099511628211ull;
+            if (*c == 0) break;
+        }
+
+        return hash;
+    }
+
+};
+
+#endif
@@ -0,0 +1,203 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include "glad/glad.h"
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+//  Draws collected during a frame and issued in an order that keeps state changes
+//  down. Every draw gets a 64 bit key with the most expensive state in the high bits:
+//
+//      63..60 pass    59..48 program    47..36 VAO    35..24 texture    23..0 depth
+//
+//  so once the keys are sorted, all draws of a pass are together, within the pass
+//  all draws of a program, and so on. Depth comes last and only orders draws that
+//  share every binding (front to back, which lets early depth testing reject more).
+//  Program, VAO and texture are GL names, which have to fit their 12 bits.
+//
+//      queue.clear();
+//      queue.add(draw, depth);             //  any order
+//      queue.sort();
+//      queue.submit();
+class RenderQueue {
+
+public:
+
+    static constexpr int passBits = 4;
+    static constexpr int nameBits = 12;
+    static constexpr int depthBits = 24;
+
+    //  Everything needed to issue one draw
+    struct Draw {
+        uint8_t pass = 0;
+        GLuint program = 0;
+        GLuint vao = 0;
+        GLuint texture = 0;             //  bound to GL_TEXTURE_2D on unit 0, 0 for none
+        GLenum mode = GL_TRIANGLES;
+        GLint first = 0;
+        GLsizei count = 0;
+        uint32_t object = 0;            //  handed to the per-draw callback of `submit`
+    };
+
+    //  Binds issued by the last `submit`
+    struct Stats {
+        unsigned long draws = 0;
+        unsigned long programChanges = 0;
+        unsigned long vaoChanges = 0;
+        unsigned long textureChanges = 0;
+    };
+
+    Stats stats;
+
+    static uint64_t makeKey(unsigned int pass, GLuint program, GLuint vao, GLuint texture, float depth) {
+
+        if (pass >= (1u << passBits) || program >= (1u << nameBits) ||
+            vao >= (1u << nameBits) || texture >= (1u << nameBits)) {
+            throw std::runtime_error("RenderQueue: pass or GL name does not fit the sort key");
+        }
+
+        //  depth in [0, 1], clamped so a draw outside the range still sorts at the end
+        float clamped = depth < 0.0f ? 0.0f : (depth > 1.0f ? 1.0f : depth);
+        uint64_t quantized = (uint64_t)(clamped * (float)((1u << depthBits) - 1));
+
+        return (uint64_t)pass << (64 - passBits)
+            | (uint64_t)program << (depthBits + 2 * nameBits)
+            | (uint64_t)vao << (depthBits + nameBits)
+            | (uint64_t)texture << depthBits
+            | quantized;
+    }
+
+    void clear() {
+        draws.clear();
+        entries.clear();
+    }
+
+    void reserve(size_t count) {
+        draws.reserve(count);
+        entries.reserve(count);
+        scratch.reserve(count);
+    }
+
+    void add(const Draw& draw, float depth) {
+
+        entries.push_back(Entry{makeKey(draw.pass, draw.program, draw.vao, draw.texture, depth), (uint32_t)draws.size(), 0});
+        draws.push_back(draw);
+    }
+
+    size_t size() const {
+        return draws.size();
+    }
+
+    //  LSD radix sort of the keys, 8 bits per pass. All eight histograms come from
+    //  one read of the keys, and a pass whose byte is the same in every key (e.g. a
+    //  single pass or no textures) is skipped since it would not move anything.
+    //  Stable, so draws with equal keys keep the order they were added in
+    void sort() {
+
+        size_t count = entries.size();
+        if (count < 2) return;
+
+        static const int digits = 8;
+        uint32_t histograms[digits][256];
+        std::memset(histograms, 0, sizeof(histograms));
+
+        for (const Entry& entry : entries) {
+            for (int digit = 0; digit < digits; digit++) {
+                histograms[digit][(entry.key >> (digit * 8)) & 0xFF]++;
+            }
+        }
+
+        scratch.resize(count);
+        Entry* source = entries.data();
+        Entry* target = scratch.data();
+
+        for (int digit = 0; digit < digits; digit++) {
+
+            uint32_t* histogram = histograms[digit];
+            int shift = digit * 8;
+
+            if (histogram[(source[0].key >> shift) & 0xFF] == count) continue;
+
+            //  counts to starting offsets
+            uint32_t offset = 0;
+            for (int bucket = 0; bucket < 256; bucket++) {
+                uint32_t bucketCount = histogram[bucket];
+                histogram[bucket] = offset;
+                offset += bucketCount;
+            }
+
+            for (size_t i = 0; i < count; i++) {
+                target[histogram[(source[i].key >> shift) & 0xFF]++] = source[i];
+            }
+
+            std::swap(source, target);
+        }
+
+        //  an odd number of passes left the result in the scratch buffer
+        if (source != entries.data()) {
+            entries.swap(scratch);
+        }
+    }
+
+    //  Issue the draws in key order, binding only what differs from the draw
+    //  before. `perDraw` runs right before each draw, e.g. to set object uniforms
+    void submit(const std::function<void(const Draw&)>& perDraw = nullptr) {
+
+        stats = Stats();
+
+        //  ~0 is never a real name, so the first draw binds everything
+        GLuint program = ~0u, vao = ~0u, texture = ~0u;
+
+        for (const Entry& entry : entries) {
+
+            const Draw& draw = draws[entry.draw];
+
+            if (draw.program != program) {
+                glUseProgram(draw.program);
+                program = draw.program;
+                stats.programChanges++;
+            }
+
+            if (draw.vao != vao) {
+                glBindVertexArray(draw.vao);
+                vao = draw.vao;
+                stats.vaoChanges++;
+            }
+
+            if (draw.texture != texture) {
+                glBindTexture(GL_TEXTURE_2D, draw.texture);
+                texture = draw.texture;
+                stats.textureChanges++;
+            }
+
+            if (perDraw) perDraw(draw);
+
+            glDrawArrays(draw.mode, draw.first, draw.count);
+            stats.draws++;
+        }
+    }
+
+    //  Sorted keys, e.g. to check the order
+    uint64_t key(size_t i) const {
+        return entries[i].key;
+    }
+
+private:
+
+    struct Entry {
+        uint64_t key;
+        uint32_t draw;          //  index into `draws`
+        uint32_t padding;
+    };
+
+    std::vector<Draw> draws;
+    std::vector<Entry> entries;
+    std::vector<Entry> scratch;
+
+};
+
+#endif
@@ -1,7 +1,13 @@
-// #ifndef SHADER_H
-// #define SHADER_H
+#ifndef SHADER_H
+#define SHADER_H
 
 #include "glad/glad.h"
+#include "uniforms.hpp"
+#include "embeddedShaders.hpp"
+#include "programCache.hpp"
+#include "uniformBuffer.hpp"
+#include "glResources.hpp"
+#include <chrono>
 #include <string>
 #include <fstream>
 #include <sstream>
@@ -10,13 +16,33 @@
 class Shader {
 
 public:
-    /// program id
-    unsigned int shaderProgram;
-    const char* vShaderCode; 
-    const char* fShaderCode;
+    /// the linked program, see GLResources
+    ProgramHandle program;
+    const char* vShaderCode = nullptr;
+    const char* fShaderCode = nullptr;
     std::string vertexCode;
     std::string fragmentCode;
 
+    /// active uniforms of the program, filled once after linking
+    UniformTable uniforms;
+
+    /// handle of the animated color set by changeColorUsingUniform
+    UniformHandle ourColorUniform;
+
+    /// true when the program declares the Frame block (see bindUniformBlocks)
+    bool usesFrameBlock = false;
+
+    /// false keeps this program out of the program binary cache and its timings
+    bool useProgramCache = true;
+
+    /// state of a program between submitShaders and finishShaders
+    bool pending = false;
+    bool cached = false;
+    ProgramCache::Key cacheKey = {0, 0, 0};
+    unsigned int pendingVertexShader = 0;
+    unsigned int pendingFragmentShader = 0;
+    std::chrono::steady_clock::time_point submitTime;
+
     /// constructor reads and builds the shader
     Shader(const char* vertexPath, const char* fragmentPath) {
 
@@ -57,23 +83,195 @@ public:
 
     }
 
-    void processShaders() {
+    /// constructor from sources embedded in the executable, no file is read and
+    /// nothing is copied: the code pointers point straight into the embedded table
+    Shader(const EmbeddedShader& vertex, const EmbeddedShader& fragment)
+        :vShaderCode(vertex.source), fShaderCode(fragment.source) {
+    }
+
+    /// shader built from source text that is already in memory, e.g. re-read from disk
+    static Shader fromSource(std::string vertexSource, std::string fragmentSource) {
+
+        /// submitShaders only picks up non-empty sources, an empty one would leave no code at all
+        if (vertexSource.empty() || fragmentSource.empty()) {
+            throw std::runtime_error("Shader: empty shader source");
+        }
+
+        Shader shader;
+        shader.vertexCode = std::move(vertexSource);
+        shader.fragmentCode = std::move(fragmentSource);
+        return shader;
+    }
+
+    /// Take over the linked program of `built` (finished), deleting the current one.
+    /// The handles of `built` are cleared so it no longer owns the program
+    void replaceProgram(Shader& built) {
 
+        finishShaders();
+
+        //  frames still in flight may use the old program, GLResources deletes it once they are done
+        GLResources::destroy(program);
+
+        program = built.program;
+        uniforms = built.uniforms;
+        ourColorUniform = built.ourColorUniform;
+        usesFrameBlock = built.usesFrameBlock;
+        vertexCode = std::move(built.vertexCode);
+        fragmentCode = std::move(built.fragmentCode);
         vShaderCode = vertexCode.c_str();
         fShaderCode = fragmentCode.c_str();
-        
-        unsigned int vertexShader =  compileShader(vShaderCode, GL_VERTEX_SHADER);
-        unsigned int fragmentShader = compileShader(fShaderCode, GL_FRAGMENT_SHADER);
 
-        createShaderProgram(vertexShader, fragmentShader);
+        built.program = ProgramHandle();
+    }
+
+    /// compile and link synchronously
+    void processShaders() {
+        submitShaders();
+        finishShaders();
+    }
+
+    /// Let the driver compile on its own threads (GL_KHR_parallel_shader_compile),
+    /// so programs submitted back to back build concurrently
+    static void enableParallelCompile() {
+
+        if (!GLAD_GL_KHR_parallel_shader_compile) {
+            std::cout << "GL_KHR_parallel_shader_compile not supported, shaders compile on first use" << std::endl;
+            return;
+        }
+
+        /// 0xFFFFFFFF lets the driver pick the number of threads
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    }
+
+    /// Start compiling and linking without waiting for the result. Nothing that
+    /// reads compile or link state is called here, so the driver is free to do the
+    /// work in the background while other programs are submitted.
+    /// `finishShaders` (or the first `useProgram`) collects the result
+    void submitShaders() {
+
+        /// sources read from files live in vertexCode/fragmentCode
+        if (!vertexCode.empty()) vShaderCode = vertexCode.c_str();
+        if (!fragmentCode.empty()) fShaderCode = fragmentCode.c_str();
+
+        submitTime = std::chrono::steady_clock::now();
+
+        /// a warm start loads the program linked by a previous run
+        cacheKey = ProgramCache::key(vShaderCode, fShaderCode);
+        cached = loadCachedProgram(cacheKey);
+
+        if (!cached) {
+            pendingVertexShader = submitShader(vShaderCode, GL_VERTEX_SHADER);
+            pendingFragmentShader = submitShader(fShaderCode, GL_FRAGMENT_SHADER);
+            submitProgram(pendingVertexShader, pendingFragmentShader);
+        }
+
+        pending = true;
+    }
+
+    /// True once `finishShaders` can run without waiting for the driver.
+    /// Without GL_KHR_parallel_shader_compile there is no way to ask, so this
+    /// reports ready and `finishShaders` waits
+    bool isReady() const {
+
+        if (!pending || cached || !GLAD_GL_KHR_parallel_shader_compile) return true;
+
+        int complete = GL_FALSE;
+        glGetProgramiv(shaderProgram(), GL_COMPLETION_STATUS_KHR, &complete);
+        return complete == GL_TRUE;
+    }
+
+    /// Wait for the program submitted by `submitShaders`, report errors and
+    /// resolve the uniforms. Does nothing when the program is already finished
+    void finishShaders() {
+
+        if (!pending) return;
+        pending = false;
+
+        if (!cached) {
+            try {
+                checkShader(pendingVertexShader, GL_VERTEX_SHADER);
+                checkShader(pendingFragmentShader, GL_FRAGMENT_SHADER);
+                checkProgram();
+            } catch (...) {
+                /// nothing of a failed build is kept
+                glDeleteShader(pendingVertexShader);
+                glDeleteShader(pendingFragmentShader);
+                GLResources::destroy(program);
+                throw;
+            }
+
+            /// delete shaders
+            glDeleteShader(pendingVertexShader);
+            glDeleteShader(pendingFragmentShader);
+
+            if (useProgramCache) ProgramCache::store(cacheKey, shaderProgram());
+        }
+
+        if (useProgramCache) ProgramCache::record(cached, std::chrono::steady_clock::now() - submitTime);
+
+        /// resolve every uniform location now so rendering never has to ask the driver
+        uniforms.introspect(shaderProgram());
+        ourColorUniform = uniform("ourColor");
+        bindUniformBlocks();
+
+    }
+
+    /// Point the shared uniform blocks the program declares at their fixed binding
+    /// points. GLSL 330 cannot say layout(binding = N), and block bindings are not
+    /// part of a program binary, so this runs after every link or cache load
+    void bindUniformBlocks() {
+        usesFrameBlock = bindUniformBlock("Frame", FrameBinding, FrameLayout::size);
+        bindUniformBlock("Object", ObjectBinding, ObjectLayout::size);
+    }
+
+    /// `size` is the std140 size the CPU side packs, a block of another size in
+    /// the shader means the two declarations went out of sync
+    bool bindUniformBlock(const char* name, GLuint binding, GLint size) {
+
+        GLuint index = glGetUniformBlockIndex(shaderProgram(), name);
+        if (index == GL_INVALID_INDEX) return false;
+
+        GLint dataSize = 0;
+        glGetActiveUniformBlockiv(shaderProgram(), index, GL_UNIFORM_BLOCK_DATA_SIZE, &dataSize);
+
+        if (dataSize != size) {
+            throw std::runtime_error(std::string("Uniform block ") + name + " does not match its std140 layout");
+        }
+
+        glUniformBlockBinding(shaderProgram(), index, binding);
+        return true;
+    }
+
+    /// The picture changes over time when the program reads the animated color
+    /// or anything else of the Frame block
+    bool isAnimated() const {
+        return ourColorUniform.valid() || usesFrameBlock;
+    }
+
+    /// Fill the program from the program binary cache, false on a miss
+    bool loadCachedProgram(const ProgramCache::Key& cacheKey) {
+
+        if (!useProgramCache || !ProgramCache::isEnabled()) return false;
 
-        /// delete shaders
-        glDeleteShader(vertexShader);
-        glDeleteShader(fragmentShader);
+        unsigned int loaded = glCreateProgram();
 
+        if (!ProgramCache::load(cacheKey, loaded)) {
+            glDeleteProgram(loaded);
+            return false;
+        }
+
+        program = GLResources::adoptProgram(loaded);
+        return true;
     }
 
     unsigned int compileShader(const char *shaderSource, unsigned int shaderType) {
+
+        unsigned int shader = submitShader(shaderSource, shaderType);
+        checkShader(shader, shaderType);
+        return shader;
+    }
+
+    unsigned int submitShader(const char *shaderSource, unsigned int shaderType) {
        
         //  In order for opengl to use the shader, it has to dynamically compile it at run-time from its
         //  source code
@@ -84,6 +282,12 @@ public:
         glShaderSource(shader, 1, &shaderSource, NULL);
         glCompileShader(shader);
 
+        return shader;
+    }
+
+    //  Querying the compile status waits for the compile to finish
+    void checkShader(unsigned int shader, unsigned int shaderType) {
+
         int success;
         char infoLog[512];
         glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
@@ -104,7 +308,6 @@ public:
             
         }
 
-        return shader;
     }
 
     //  Shader Program object is the final linked version of multiple shaders combined
@@ -113,22 +316,33 @@ public:
     //  When linking the shaders into a program, it links the output of each shader to the inputs of the next shader
     void createShaderProgram(unsigned int vtxShader, unsigned int fragShader) {
 
+        submitProgram(vtxShader, fragShader);
+        checkProgram();
+    }
+
+    void submitProgram(unsigned int vtxShader, unsigned int fragShader) {
+
         //  create shader program
-        shaderProgram = glCreateProgram();
+        program = GLResources::adoptProgram(glCreateProgram());
 
         //  attach the compiled shaders to the program
-        glAttachShader(shaderProgram, vtxShader);
-        glAttachShader(shaderProgram, fragShader);
+        glAttachShader(shaderProgram(), vtxShader);
+        glAttachShader(shaderProgram(), fragShader);
         
-        //  link the shaders via the shaderProgram
-        glLinkProgram(shaderProgram);
+        //  link the shaders via the shader program, keeping the binary retrievable for the cache
+        ProgramCache::prepare(shaderProgram());
+        glLinkProgram(shaderProgram());
+
+    }
+
+    void checkProgram() {
 
         int success;
         char infoLog[512];
-        glGetProgramiv(shaderProgram, GL_COMPILE_STATUS, &success);
+        glGetProgramiv(shaderProgram(), GL_LINK_STATUS, &success);
     
         if (!success) {
-            glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
+            glGetProgramInfoLog(shaderProgram(), 512, NULL, infoLog);
             std::cout << infoLog << std::endl;
             throw std::runtime_error("Shader Program Linking Failed!");
     
@@ -136,29 +350,89 @@ public:
 
     }
 
-    /// use/activate the shader
+    /// GL name of the program, 0 before it was built or after `destroy`
+    unsigned int shaderProgram() const {
+        return GLResources::get(program);
+    }
+
+    /// Queue the program for deletion (see GLResources)
+    void destroy() {
+        GLResources::destroy(program);
+    }
+
+    /// use/activate the shader, waiting for it first if it is still compiling
     void useProgram() {
-        glUseProgram(shaderProgram);
+        finishShaders();
+        glUseProgram(shaderProgram());
     }
 
-    void changeColorUsingUniform() {
-        float timeValue = glfwGetTime();
+    /// For programs with a plain `uniform vec4 ourColor`. The render loop shares the
+    /// same color with every program through the Frame block instead
+    void changeColorUsingUniform(float timeValue) {
+
+        Vec4 color = animatedColor(timeValue);
+
+        /// set the uniform value using the location cached after linking
+        setVec4(ourColorUniform, color.v);
+    }
+
+    static Vec4 animatedColor(float timeValue) {
         float greenValue = (std::sin(timeValue) / 2.0f) + 0.5f;
         float blueValue = (std::sin(timeValue) / 6.0f) + 0.6f;
         float redValue = blueValue + greenValue;
+        return Vec4{{redValue, greenValue, blueValue, 1.0f}};
+    }
 
-        /// Query the uniform's location using the name
-        int vertexColorLocation = glGetUniformLocation(shaderProgram, "ourColor");
-        
-        /// set the uniform value
-        glUniform4f(vertexColorLocation, redValue, greenValue, blueValue, 1.0f);
+    /// Look up a uniform once (e.g. at load time) and keep the handle for the setters.
+    /// Uses the table built after linking, no GL query involved
+    UniformHandle uniform(const char* name) const {
+        return uniforms.find(name);
+    }
+
+    /// utility uniform functions, they act on the program currently in use.
+    /// Invalid handles are skipped without touching GL
+    void setBool(UniformHandle handle, bool value) const {
+        if (handle.valid()) glUniform1i(handle.location, (int)value);
+    }
+
+    void setInt(UniformHandle handle, int value) const {
+        if (handle.valid()) glUniform1i(handle.location, value);
+    }
+
+    void setFloat(UniformHandle handle, float value) const {
+        if (handle.valid()) glUniform1f(handle.location, value);
     }
 
-    /// utility uniform functions
-    void setBool(const std::string &name, bool value) const;
-    void setInt(const std::string &name, int value) const;
-    void setFloat(const std::string &name, float value) const;
+    void setVec3(UniformHandle handle, const float* value) const {
+        if (handle.valid()) glUniform3fv(handle.location, 1, value);
+    }
+
+    void setVec4(UniformHandle handle, const float* value) const {
+        if (handle.valid()) glUniform4fv(handle.location, 1, value);
+    }
+
+    void setVec4(UniformHandle handle, float x, float y, float z, float w) const {
+        if (handle.valid()) glUniform4f(handle.location, x, y, z, w);
+    }
+
+    /// name based versions for code outside the hot path, they cost a hash lookup per call
+    void setBool(const std::string &name, bool value) const {
+        setBool(uniform(name.c_str()), value);
+    }
+
+    void setInt(const std::string &name, int value) const {
+        setInt(uniform(name.c_str()), value);
+    }
+
+    void setFloat(const std::string &name, float value) const {
+        setFloat(uniform(name.c_str()), value);
+    }
+
+private:
+
+    /// only for fromSource
+    Shader() {}
 
 };
 
-// #endif 
\ No newline at end of file
+#endif
\ No newline at end of file
@@ -0,0 +1,304 @@
+#ifndef SHADER_WATCHER_H
+#define SHADER_WATCHER_H
+
+#include "shader.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+//  Watches a vertex/fragment shader pair on disk from a background thread.
+//  Edits are picked up through inotify on the directory (editors often save by
+//  writing a new file and renaming it over the old one, which a watch on the file
+//  itself would lose), debounced, and the new sources read off the render thread.
+//  The render thread collects them with `takeSources`; no GL is touched here
+class ShaderWatcher {
+
+public:
+
+    //  quiet time after the last event before the files are read, editors
+    //  touch a file several times per save
+    static const int debounceMs = 50;
+
+    //  called from the watcher thread after new sources were read, e.g. to wake
+    //  a render loop that is blocked waiting for events. Set before `start`
+    std::function<void()> onChange;
+
+    ~ShaderWatcher() {
+        stop();
+    }
+
+    //  Start watching `directory`/`vertexName` and `directory`/`fragmentName`.
+    //  The current files are read right away, so they replace whatever sources
+    //  the program was built from (e.g. the embedded ones)
+    bool start(const std::string& _directory, const std::string& _vertexName, const std::string& _fragmentName) {
+
+        directory = _directory;
+        vertexName = _vertexName;
+        fragmentName = _fragmentName;
+
+#ifdef __linux__
+        inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+        if (inotifyFd < 0 || wakeFd < 0 ||
+            inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+            std::printf("shader watcher: cannot watch %s\n", directory.c_str());
+            closeFds();
+            return false;
+        }
+
+        readSources();
+        thread = std::thread(&ShaderWatcher::run, this);
+        std::printf("shader watcher: watching %s/%s and %s\n", directory.c_str(), vertexName.c_str(), fragmentName.c_str());
+        return true;
+#else
+        std::printf("shader watcher: needs inotify (Linux)\n");
+        return false;
+#endif
+    }
+
+    void stop() {
+
+#ifdef __linux__
+        if (thread.joinable()) {
+            uint64_t one = 1;
+            if (write(wakeFd, &one, sizeof(one)) < 0) std::perror("shader watcher");
+            thread.join();
+        }
+
+        closeFds();
+#endif
+    }
+
+    bool hasChanges() const {
+        return changed.load(std::memory_order_acquire);
+    }
+
+    //  Newest sources read since the last call, false when nothing changed
+    bool takeSources(std::string& vertexSource, std::string& fragmentSource) {
+
+        if (!changed.load(std::memory_order_acquire)) return false;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        vertexSource = std::move(pendingVertex);
+        fragmentSource = std::move(pendingFragment);
+        changed.store(false, std::memory_order_relaxed);
+        return true;
+    }
+
+private:
+
+    std::string directory;
+    std::string vertexName;
+    std::string fragmentName;
+
+    std::thread thread;
+    int inotifyFd = -1;
+    int wakeFd = -1;         //  written by `stop` to end the thread's poll
+
+    //  handed from the watcher thread to the render thread
+    std::mutex mutex;
+    std::string pendingVertex;
+    std::string pendingFragment;
+    std::atomic<bool> changed{false};
+
+#ifdef __linux__
+    void run() {
+
+        bool dirty = false;
+
+        while (true) {
+
+            pollfd fds[2] = {{inotifyFd, POLLIN, 0}, {wakeFd, POLLIN, 0}};
+
+            //  while debouncing wake up once the directory went quiet
+            int ready = poll(fds, 2, dirty ? debounceMs : -1);
+
+            if (ready < 0) continue;
+            if (fds[1].revents & POLLIN) break;
+
+            if (ready == 0) {
+                dirty = false;
+                readSources();
+                continue;
+            }
+
+            if (fds[0].revents & POLLIN) {
+                dirty = drainEvents() || dirty;
+            }
+        }
+    }
+
+    //  True when one of the watched files was among the events
+    bool drainEvents() {
+
+        alignas(inotify_event) char buffer[4096];
+        bool relevant = false;
+        ssize_t length;
+
+        while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+
+            for (char* next = buffer; next < buffer + length; ) {
+
+                const inotify_event* event = (const inotify_event*)next;
+
+                if (event->len > 0 && (vertexName == event->name || fragmentName == event->name)) {
+                    relevant = true;
+                }
+
+                next += sizeof(inotify_event) + event->len;
+            }
+        }
+
+        return relevant;
+    }
+
+    void closeFds() {
+
+        if (inotifyFd >= 0) close(inotifyFd);
+        if (wakeFd >= 0) close(wakeFd);
+        inotifyFd = wakeFd = -1;
+    }
+#endif
+
+    //  A file caught in the middle of being replaced reads as missing or empty;
+    //  it is skipped and the next event brings the complete version
+    void readSources() {
+
+        std::string vertexSource, fragmentSource;
+
+        if (!readFile(directory + "/" + vertexName, vertexSource) ||
+            !readFile(directory + "/" + fragmentName, fragmentSource)) {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pendingVertex = std::move(vertexSource);
+            pendingFragment = std::move(fragmentSource);
+            changed.store(true, std::memory_order_release);
+        }
+
+        if (onChange) onChange();
+    }
+
+    static bool readFile(const std::string& path, std::string& contents) {
+
+        std::ifstream file(path, std::ifstream::in | std::ifstream::binary);
+        if (!file) return false;
+
+        std::stringstream stream;
+        stream << file.rdbuf();
+        contents = stream.str();
+        return !contents.empty();
+    }
+
+};
+
+//  Swaps new shader sources into a live Shader without stalling the render loop.
+//  Call `update` once per frame, before anything is drawn: new sources are
+//  submitted for an asynchronous build, and the finished program replaces the live
+//  one at the start of a later frame. A program that fails to compile or link is
+//  reported and dropped, the live one keeps rendering
+class ShaderReloader {
+
+public:
+
+    ShaderWatcher watcher;
+
+    //  programs swapped in / builds that failed
+    unsigned int reloads = 0;
+    unsigned int failures = 0;
+
+    bool start(const std::string& directory, const std::string& vertexName, const std::string& fragmentName) {
+        active = watcher.start(directory, vertexName, fragmentName);
+        return active;
+    }
+
+    //  True once a new program was swapped into `live`
+    bool update(Shader& live) {
+
+        if (!active) return false;
+
+        std::string vertexSource, fragmentSource;
+
+        //  a newer edit supersedes a build still in flight
+        if (watcher.takeSources(vertexSource, fragmentSource)) {
+
+            discardCandidate();
+
+            //  e.g. the first read when the files match the embedded sources
+            if (live.vShaderCode && live.fShaderCode &&
+                vertexSource == live.vShaderCode && fragmentSource == live.fShaderCode) return false;
+
+            candidate = std::make_unique<Shader>(Shader::fromSource(std::move(vertexSource), std::move(fragmentSource)));
+            candidate->submitShaders();
+        }
+
+        if (!candidate || !candidate->isReady()) return false;
+
+        try {
+            candidate->finishShaders();
+        } catch (const std::exception& e) {
+            failures++;
+            std::printf("shader reload failed (%s), keeping the current program\n", e.what());
+            candidate.reset();
+            return false;
+        }
+
+        live.replaceProgram(*candidate);
+        candidate.reset();
+        reloads++;
+        std::printf("shader reloaded\n");
+        return true;
+    }
+
+    //  New sources waiting or a build in flight, `update` has work to do
+    bool busy() const {
+        return active && (candidate || watcher.hasChanges());
+    }
+
+    //  Stop watching and drop a build in flight. Needs the context to be current
+    void stop() {
+
+        watcher.stop();
+        discardCandidate();
+        active = false;
+    }
+
+private:
+
+    bool active = false;
+    std::unique_ptr<Shader> candidate;
+
+    void discardCandidate() {
+
+        if (!candidate) return;
+
+        //  collect it so its shader objects are released, whatever the outcome
+        try {
+            candidate->finishShaders();
+            candidate->destroy();
+        } catch (const std::exception&) {
+        }
+
+        candidate.reset();
+    }
+
+};
+
+#endif
@@ -0,0 +1,13 @@
+#version 330 core
+layout (location=0) in vec3 aPos;   
+layout (location=1) in vec3 aColor;
+layout (location=2) in vec4 aTransform;     // offset in xyz, scale in w
+layout (location=3) in vec3 aInstanceColor;
+
+out vec3 ourColor;
+
+void main()
+{
+    gl_Position = vec4(aPos * aTransform.w + aTransform.xyz, 1.0);
+    ourColor = aColor * aInstanceColor;
+}
\ No newline at end of file
@@ -0,0 +1,15 @@
+#version 330 core
+layout (location=0) in vec3 aPos;   
+layout (location=1) in vec3 aColor;
+
+//  per-object equivalent of the attributes in instanced.vs
+uniform vec4 transform;     // offset in xyz, scale in w
+uniform vec3 objectColor;
+
+out vec3 ourColor;
+
+void main()
+{
+    gl_Position = vec4(aPos * transform.w + transform.xyz, 1.0);
+    ourColor = aColor * objectColor;
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+#version 330 core
+layout (location=0) in vec3 aPos;   
+layout (location=1) in vec3 aColor;
+
+//  object.vs with the per-object values in a range of one uniform buffer
+layout (std140) uniform Object {
+    vec4 transform;         // offset in xyz, scale in w
+    vec3 objectColor;
+};
+
+out vec3 ourColor;
+
+void main()
+{
+    gl_Position = vec4(aPos * transform.w + transform.xyz, 1.0);
+    ourColor = aColor * objectColor;
+}
\ No newline at end of file
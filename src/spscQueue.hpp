@@ -0,0 +1,73 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+//  Bounded lock-free queue between exactly one producer and one consumer thread.
+//  The producer only writes `tail` and the consumer only writes `head`, so a push
+//  or pop is a copy plus one release store, with no lock and no CAS loop. The
+//  indices sit on separate cache lines so the two threads do not keep stealing
+//  the same line from each other
+//
+//      SPSCQueue<InputEvent, 256> queue;
+//      queue.push(event);                  //  producer thread, false when full
+//      while (queue.pop(event)) ...        //  consumer thread, false when empty
+template <typename T, size_t Capacity>
+class SPSCQueue {
+
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "SPSCQueue: capacity must be a power of two");
+
+public:
+
+    //  Producer side
+    bool push(const T& item) {
+
+        size_t currentTail = tail.load(std::memory_order_relaxed);
+
+        if (currentTail - headCache == Capacity) {
+            headCache = head.load(std::memory_order_acquire);
+            if (currentTail - headCache == Capacity) return false;
+        }
+
+        slots[currentTail & (Capacity - 1)] = item;
+        tail.store(currentTail + 1, std::memory_order_release);
+        return true;
+    }
+
+    //  Consumer side
+    bool pop(T& item) {
+
+        size_t currentHead = head.load(std::memory_order_relaxed);
+
+        if (currentHead == tailCache) {
+            tailCache = tail.load(std::memory_order_acquire);
+            if (currentHead == tailCache) return false;
+        }
+
+        item = slots[currentHead & (Capacity - 1)];
+        head.store(currentHead + 1, std::memory_order_release);
+        return true;
+    }
+
+    //  Either side, only a snapshot while the other side is running
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+private:
+
+    static constexpr size_t cacheLine = 64;
+
+    //  indices only ever grow, the slot is the index modulo Capacity
+    alignas(cacheLine) std::atomic<size_t> head{0};     //  next slot to pop, written by the consumer
+    size_t tailCache = 0;                               //  consumer's last view of `tail`
+
+    alignas(cacheLine) std::atomic<size_t> tail{0};     //  next slot to push, written by the producer
+    size_t headCache = 0;                               //  producer's last view of `head`
+
+    alignas(cacheLine) T slots[Capacity];
+
+};
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include "glad/glad.h"
+#include "glResources.hpp"
+#include <cstdint>
+#include <stdexcept>
+
+//  Ring buffer for vertex data that changes every frame.
+//  One GL buffer is split into `numRegions` regions; the CPU writes region N
+//  while the GPU may still read N-1 and N-2. Writes go through an unsynchronized
+//  glMapBufferRange, so the driver never stalls to protect data in flight, and a
+//  fence placed after the draws of each region tells when it is safe to reuse it.
+//
+//  Per frame:
+//      void* data = stream.map(bytes);     //  write vertices to data
+//      stream.unmap();
+//      draw from stream.offset()           //  e.g. first vertex = offset() / stride
+//      stream.endFrame();                  //  fence the region, move to the next one
+class StreamBuffer {
+
+public:
+
+    static const int numRegions = 3;
+
+    BufferHandle buffer;
+    GLsizeiptr regionSize = 0;
+
+    //  times `map` had to wait for the GPU to release a region
+    unsigned long stalls = 0;
+
+    //  Allocate the backing store. Needs the VAO that will read from it bound,
+    //  since the buffer is left bound to GL_ARRAY_BUFFER for setVertexAttribute
+    void create(GLsizeiptr _regionSize) {
+
+        regionSize = _regionSize;
+
+        buffer = GLResources::createBuffer();
+        glBindBuffer(GL_ARRAY_BUFFER, GLResources::get(buffer));
+        glBufferData(GL_ARRAY_BUFFER, regionSize * numRegions, NULL, GL_STREAM_DRAW);
+
+        for (int i = 0; i < numRegions; i++) fences[i] = 0;
+    }
+
+    //  Map `size` bytes at the start of the current region for writing
+    void* map(GLsizeiptr size) {
+
+        if (size > regionSize) {
+            throw std::runtime_error("StreamBuffer: write larger than a region");
+        }
+
+        waitForRegion(region);
+
+        glBindBuffer(GL_ARRAY_BUFFER, GLResources::get(buffer));
+        void* data = glMapBufferRange(GL_ARRAY_BUFFER, offset(), size,
+            GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+
+        if (data == NULL) {
+            throw std::runtime_error("StreamBuffer: glMapBufferRange failed");
+        }
+
+        return data;
+    }
+
+    void unmap() {
+        glBindBuffer(GL_ARRAY_BUFFER, GLResources::get(buffer));
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+
+    //  Byte offset of the current region inside `buffer`
+    GLintptr offset() const {
+        return (GLintptr)region * regionSize;
+    }
+
+    //  Call once every draw reading the current region has been issued
+    void endFrame() {
+
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        region = (region + 1) % numRegions;
+    }
+
+    //  The buffer goes back to GLResources, which deletes it once the regions
+    //  still being read have been drawn
+    void destroy() {
+
+        for (int i = 0; i < numRegions; i++) {
+            if (fences[i]) glDeleteSync(fences[i]);
+            fences[i] = 0;
+        }
+
+        GLResources::destroy(buffer);
+    }
+
+private:
+
+    int region = 0;
+    GLsync fences[numRegions] = {};
+
+    void waitForRegion(int index) {
+
+        if (!fences[index]) return;
+
+        //  poll first, a fence that is already signaled costs no wait
+        GLenum status = glClientWaitSync(fences[index], 0, 0);
+
+        if (status == GL_TIMEOUT_EXPIRED) {
+            stalls++;
+
+            //  flush so the fence is guaranteed to signal, then wait in 1 ms steps
+            GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+            do {
+                status = glClientWaitSync(fences[index], flags, 1000000);
+                flags = 0;
+            } while (status == GL_TIMEOUT_EXPIRED);
+        }
+
+        if (status == GL_WAIT_FAILED) {
+            throw std::runtime_error("StreamBuffer: glClientWaitSync failed");
+        }
+
+        glDeleteSync(fences[index]);
+        fences[index] = 0;
+    }
+
+};
+
+#endif
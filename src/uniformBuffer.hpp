@@ -0,0 +1,198 @@
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+#include "glad/glad.h"
+#include "glResources.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+//  GLSL types as they are stored on the CPU side of a uniform block
+template <int N> struct Vec { float v[N]; };
+using Vec2 = Vec<2>;
+using Vec3 = Vec<3>;
+using Vec4 = Vec<4>;
+struct Mat4 { float m[16]; };      //  column major, like GLSL
+
+//  std140 base alignment and size of each type (OpenGL 4.6 spec, 7.6.2.2)
+template <typename T> struct Std140;
+template <> struct Std140<float> { static constexpr unsigned int alignment = 4, size = 4; };
+template <> struct Std140<int32_t> { static constexpr unsigned int alignment = 4, size = 4; };
+template <> struct Std140<uint32_t> { static constexpr unsigned int alignment = 4, size = 4; };
+template <> struct Std140<Vec2> { static constexpr unsigned int alignment = 8, size = 8; };
+template <> struct Std140<Vec3> { static constexpr unsigned int alignment = 16, size = 12; };
+template <> struct Std140<Vec4> { static constexpr unsigned int alignment = 16, size = 16; };
+template <> struct Std140<Mat4> { static constexpr unsigned int alignment = 16, size = 64; };
+
+//  Offsets of members laid out one after the other, each at its base alignment
+template <typename... Members>
+constexpr std::array<unsigned int, sizeof...(Members)> std140Offsets() {
+
+    constexpr unsigned int alignments[] = {Std140<Members>::alignment...};
+    constexpr unsigned int sizes[] = {Std140<Members>::size...};
+
+    std::array<unsigned int, sizeof...(Members)> result = {};
+    unsigned int position = 0;
+
+    for (size_t i = 0; i < sizeof...(Members); i++) {
+        position = (position + alignments[i] - 1) / alignments[i] * alignments[i];
+        result[i] = position;
+        position += sizes[i];
+    }
+
+    return result;
+}
+
+//  Compile-time std140 layout of a uniform block, members in declaration order:
+//
+//      //  layout(std140) uniform Frame { vec4 color; float time; };
+//      using FrameLayout = Std140Layout<Vec4, float>;
+//      static_assert(FrameLayout::offset<1>() == 16, "");
+//
+//  A vec3 followed by a float shares one 16 byte slot, as in GLSL
+template <typename... Members>
+class Std140Layout {
+
+    static_assert(sizeof...(Members) > 0, "Std140Layout: needs at least one member");
+
+    static constexpr std::array<unsigned int, sizeof...(Members)> offsets = std140Offsets<Members...>();
+    static constexpr unsigned int sizes[] = {Std140<Members>::size...};
+
+public:
+
+    static constexpr size_t count = sizeof...(Members);
+
+    template <size_t I>
+    using Type = typename std::tuple_element<I, std::tuple<Members...>>::type;
+
+    template <size_t I>
+    static constexpr unsigned int offset() {
+        return offsets[I];
+    }
+
+    //  whole block, padded to a vec4 like the driver reports it
+    static constexpr unsigned int size = (offsets[count - 1] + sizes[count - 1] + 15) / 16 * 16;
+
+};
+
+//  CPU copy of one block in its std140 layout, ready to be uploaded as is
+template <typename Layout>
+class Std140Block {
+
+public:
+
+    unsigned char data[Layout::size] = {};
+
+    template <size_t I>
+    void set(const typename Layout::template Type<I>& value) {
+        std::memcpy(data + Layout::template offset<I>(), &value, Std140<typename Layout::template Type<I>>::size);
+    }
+
+};
+
+//  Fixed binding points, assigned to the blocks of every program by name
+//  (see Shader::bindUniformBlocks), so any program can read the shared blocks
+enum UniformBinding {
+    FrameBinding = 0,       //  uniform Frame, per-frame values shared by all programs
+    ObjectBinding = 1       //  uniform Object, a range of the buffer per drawn object
+};
+
+//  One GL_UNIFORM_BUFFER holding the frame block and every per-object block.
+//  Blocks are sub-allocated from a CPU shadow copy, which goes to the GPU in a
+//  single upload per frame; draws then select their block with glBindBufferRange.
+//
+//      size_t frameBlock = buffer.allocate(sizeof(frame.data));
+//      ...
+//      buffer.write(frameBlock, frame.data, sizeof(frame.data));
+//      buffer.upload();
+//      buffer.bindRange(FrameBinding, frameBlock, sizeof(frame.data));
+class UniformBuffer {
+
+public:
+
+    BufferHandle buffer;
+
+    //  GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, every block starts on a multiple of it
+    GLint offsetAlignment = 256;
+
+    void create(size_t capacity) {
+
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+
+        shadow.assign(capacity, 0);
+        used = 0;
+
+        buffer = GLResources::createBuffer();
+        glBindBuffer(GL_UNIFORM_BUFFER, GLResources::get(buffer));
+        glBufferData(GL_UNIFORM_BUFFER, capacity, NULL, GL_DYNAMIC_DRAW);
+    }
+
+    //  Reserve `size` bytes, returns the offset of the block
+    size_t allocate(size_t size) {
+
+        size_t offset = (used + offsetAlignment - 1) / offsetAlignment * offsetAlignment;
+
+        if (offset + size > shadow.size()) {
+            throw std::runtime_error("UniformBuffer: out of space");
+        }
+
+        used = offset + size;
+        return offset;
+    }
+
+    //  Forget every allocation, e.g. when the set of objects changes
+    void reset() {
+        used = 0;
+    }
+
+    void write(size_t offset, const void* data, size_t size) {
+        std::memcpy(&shadow[offset], data, size);
+    }
+
+    //  Send every block in one call. The store is orphaned first, so a frame
+    //  still reading last frame's blocks never makes this wait
+    void upload() {
+
+        if (used == 0) return;
+
+        glBindBuffer(GL_UNIFORM_BUFFER, GLResources::get(buffer));
+        glBufferData(GL_UNIFORM_BUFFER, shadow.size(), NULL, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, used, shadow.data());
+    }
+
+    void bindRange(GLuint binding, size_t offset, size_t size) {
+        glBindBufferRange(GL_UNIFORM_BUFFER, binding, GLResources::get(buffer), offset, size);
+    }
+
+    void destroy() {
+
+        //  deleted by GLResources once the frames binding it are done
+        GLResources::destroy(buffer);
+        shadow.clear();
+        used = 0;
+    }
+
+private:
+
+    std::vector<unsigned char> shadow;
+    size_t used = 0;
+
+};
+
+//  layout(std140) uniform Frame { vec4 color; float time; };
+enum FrameMember { FrameColor, FrameTime };
+using FrameLayout = Std140Layout<Vec4, float>;
+
+//  layout(std140) uniform Object { vec4 transform; vec3 color; };
+enum ObjectMember { ObjectTransform, ObjectColor };
+using ObjectLayout = Std140Layout<Vec4, Vec3>;
+
+static_assert(FrameLayout::offset<FrameTime>() == 16 && FrameLayout::size == 32, "FrameLayout: std140 mismatch");
+static_assert(ObjectLayout::offset<ObjectColor>() == 16 && ObjectLayout::size == 32, "ObjectLayout: std140 mismatch");
+static_assert(Std140Layout<Vec3, float>::offset<1>() == 12, "Std140Layout: float packs after vec3");
+
+#endif
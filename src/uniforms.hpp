@@ -0,0 +1,147 @@
+#ifndef UNIFORMS_H
+#define UNIFORMS_H
+
+#include "glad/glad.h"
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/// Precomputed reference to a uniform of a linked program.
+/// Look it up once with `Shader::uniform` and pass it to the setters every frame
+struct UniformHandle {
+
+    int location = -1;
+
+    /// uniforms the linker optimised away (or that never existed) have no location
+    bool valid() const {
+        return location >= 0;
+    }
+
+};
+
+/// Every active uniform of a program, read once after linking.
+/// Flat open-addressing hash table keyed by name, so a lookup is one hash
+/// and usually one probe, and never goes back to the driver
+class UniformTable {
+
+public:
+
+    struct Entry {
+        uint32_t hash = 0;
+        int location = -1;
+        unsigned int type = 0;      //  GL_FLOAT_VEC4, GL_SAMPLER_2D, ...
+        int size = 0;               //  array length, 1 for non-arrays
+        std::string name;
+    };
+
+    /// Query GL_ACTIVE_UNIFORMS of `program` and fill the table
+    void introspect(unsigned int program) {
+
+        int count = 0;
+        int maxLength = 0;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+        /// keep the load factor at or below one half, arrays take two entries
+        size_t capacity = 8;
+        while (capacity < (size_t)count * 4) capacity *= 2;
+
+        entries.assign(capacity, Entry());
+        mask = capacity - 1;
+        numUniforms = 0;
+
+        std::vector<char> nameBuffer(maxLength > 0 ? maxLength : 1);
+
+        for (int i = 0; i < count; i++) {
+
+            Entry entry;
+            GLsizei length = 0;
+            glGetActiveUniform(program, i, (GLsizei)nameBuffer.size(), &length, &entry.size, &entry.type, &nameBuffer[0]);
+
+            entry.name.assign(&nameBuffer[0], length);
+            entry.location = glGetUniformLocation(program, entry.name.c_str());
+
+            /// uniforms inside blocks have no location and are set through buffers
+            if (entry.location < 0) continue;
+
+            entry.hash = hashName(entry.name.c_str());
+            insert(entry);
+            numUniforms++;
+
+            /// arrays are reported as "name[0]", register them under "name" as well
+            size_t bracket = entry.name.find('[');
+            if (bracket != std::string::npos) {
+                entry.name.erase(bracket);
+                entry.hash = hashName(entry.name.c_str());
+                insert(entry);
+            }
+        }
+
+    }
+
+    /// Location of `name`, or an invalid handle if the program has no such active uniform
+    UniformHandle find(const char* name) const {
+
+        UniformHandle handle;
+        if (entries.empty()) return handle;
+
+        uint32_t hash = hashName(name);
+
+        for (size_t slot = hash & mask; ; slot = (slot + 1) & mask) {
+
+            const Entry& entry = entries[slot];
+
+            if (entry.location < 0) break;      //  empty slot ends the probe sequence
+
+            if (entry.hash == hash && entry.name == name) {
+                handle.location = entry.location;
+                break;
+            }
+        }
+
+        return handle;
+    }
+
+    /// Active uniforms, an array counts once
+    size_t size() const {
+        return numUniforms;
+    }
+
+    const std::vector<Entry>& slots() const {
+        return entries;
+    }
+
+private:
+
+    std::vector<Entry> entries;
+    size_t mask = 0;
+    size_t numUniforms = 0;
+
+    /// 32 bit FNV-1a
+    static uint32_t hashName(const char* name) {
+
+        uint32_t hash = 2166136261u;
+
+        for (; *name; name++) {
+            hash ^= (unsigned char)*name;
+            hash *= 16777619u;
+        }
+
+        return hash;
+    }
+
+    void insert(const Entry& entry) {
+
+        size_t slot = entry.hash & mask;
+
+        while (entries[slot].location >= 0) {
+            slot = (slot + 1) & mask;
+        }
+
+        entries[slot] = entry;
+    }
+
+};
+
+#endif
@@ -0,0 +1,228 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include "glad/glad.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include "vertexLayout.hpp"
+
+//  One vertex attribute as stored in the VBO, and where its values come from
+//  in the float vertices it is quantized from
+struct VertexAttribute {
+    unsigned int index;         //  layout (location = index) in the shader
+    int components;
+    GLenum type;                //  GL_FLOAT, GL_HALF_FLOAT, GL_UNSIGNED_BYTE, GL_INT_2_10_10_10_REV, ...
+    bool normalized;            //  integers are mapped to [0, 1] / [-1, 1]
+    unsigned int offset;        //  bytes from the start of the vertex
+    unsigned int sourceOffset;  //  first float of the attribute in the float vertex
+};
+
+//  Memory layout of one vertex, replacing the hardcoded GL_FLOAT / 6 * sizeof(float)
+//  layout so smaller types can be used for attributes that do not need 32 bit floats.
+//  Only drives quantization; the GL attribute setup comes from a VertexLayout, and
+//  `fromLayout` builds the format from that layout so the two always agree
+class VertexFormat {
+
+public:
+
+    std::vector<VertexAttribute> attributes;
+    unsigned int stride = 0;
+
+    //  Append an attribute after the previous ones. Attributes are kept 4 byte
+    //  aligned since some drivers fall back to slow paths otherwise
+    VertexFormat& add(unsigned int index, int components, GLenum type, bool normalized, unsigned int sourceOffset) {
+
+        VertexAttribute attribute;
+        attribute.index = index;
+        attribute.components = components;
+        attribute.type = type;
+        attribute.normalized = normalized;
+        attribute.offset = stride;
+        attribute.sourceOffset = sourceOffset;
+
+        attributes.push_back(attribute);
+        stride += (attributeSize(attribute) + 3) & ~3u;
+        return *this;
+    }
+
+    //  The runtime copy of `Layout`, attribute `i` read from the float vertex
+    //  starting at `sourceOffsets[i]`
+    template <typename Layout>
+    static VertexFormat fromLayout(const unsigned int (&sourceOffsets)[Layout::count]) {
+
+        VertexFormat format;
+        size_t i = 0;
+
+        Layout::forEach([&](auto attribute) {
+            using A = decltype(attribute);
+            format.add(A::index, A::components, A::type, A::normalized, sourceOffsets[i++]);
+        });
+
+        return format;
+    }
+
+    //  position (vec3) and color (vec3) as 32 bit floats: 24 bytes per vertex
+    static VertexFormat floatPositionColor() {
+        return fromLayout<PositionColorLayout>({0, 3});
+    }
+
+    //  half float position padded to 4 components (w = 1) and normalized byte
+    //  color with alpha: 12 bytes per vertex
+    static VertexFormat compactPositionColor() {
+        return fromLayout<CompactPositionColorLayout>({0, 3});
+    }
+
+    //  As `compactPositionColor` plus a normal (read from floats 6..8) packed
+    //  into 2_10_10_10: 16 bytes per vertex instead of 36
+    static VertexFormat compactPositionColorNormal() {
+        return fromLayout<CompactPositionColorNormalLayout>({0, 3, 6});
+    }
+
+    static unsigned int attributeSize(const VertexAttribute& attribute) {
+
+        switch (attribute.type) {
+            case GL_FLOAT: return 4 * attribute.components;
+            case GL_HALF_FLOAT: return 2 * attribute.components;
+            case GL_UNSIGNED_BYTE:
+            case GL_BYTE: return attribute.components;
+            case GL_UNSIGNED_SHORT:
+            case GL_SHORT: return 2 * attribute.components;
+            case GL_INT_2_10_10_10_REV: return 4;
+            default: throw std::runtime_error("VertexFormat: unsupported attribute type");
+        }
+    }
+
+};
+
+//  CPU side conversion of float vertices into the types of a VertexFormat
+namespace Quantize {
+
+    //  IEEE 754 binary32 -> binary16, rounding to nearest even
+    inline uint16_t floatToHalf(float value) {
+
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+
+        uint32_t sign = (bits >> 16) & 0x8000u;
+        uint32_t magnitude = bits & 0x7FFFFFFFu;
+
+        if (magnitude >= 0x7F800000u) {
+            //  inf stays inf, NaN stays a (quiet) NaN
+            return (uint16_t)(sign | 0x7C00u | (magnitude > 0x7F800000u ? 0x200u : 0u));
+        }
+
+        if (magnitude >= 0x47800000u) {
+            return (uint16_t)(sign | 0x7C00u);      //  too large, rounds to inf
+        }
+
+        if (magnitude < 0x38800000u) {
+            //  subnormal half: let the FPU do the rounding by adding a magic number
+            float f;
+            uint32_t m = magnitude;
+            std::memcpy(&f, &m, sizeof(f));
+            f += 0.5f;
+            uint32_t rounded;
+            std::memcpy(&rounded, &f, sizeof(rounded));
+            return (uint16_t)(sign | (rounded - 0x3F000000u));
+        }
+
+        //  rebias the exponent (127 -> 15) and round the 13 dropped mantissa bits
+        uint32_t mantissaOdd = (magnitude >> 13) & 1u;
+        magnitude += 0xC8000FFFu + mantissaOdd;
+        return (uint16_t)(sign | (magnitude >> 13));
+    }
+
+    inline int32_t toSigned(float value, int bits) {
+        float scale = (float)((1 << (bits - 1)) - 1);
+        return (int32_t)std::lround(std::max(-1.0f, std::min(1.0f, value)) * scale);
+    }
+
+    inline uint32_t toUnsigned(float value, int bits) {
+        float scale = (float)((1u << bits) - 1);
+        return (uint32_t)std::lround(std::max(0.0f, std::min(1.0f, value)) * scale);
+    }
+
+    //  x, y, z in 10 bit signed normalized, w in the top 2 bits
+    inline uint32_t packSnorm2_10_10_10(const float* values, int components) {
+
+        uint32_t packed = 0;
+
+        for (int c = 0; c < 3; c++) {
+            float value = c < components ? values[c] : 0.0f;
+            packed |= ((uint32_t)toSigned(value, 10) & 0x3FFu) << (10 * c);
+        }
+
+        float w = components > 3 ? values[3] : 0.0f;
+        packed |= ((uint32_t)toSigned(w, 2) & 0x3u) << 30;
+        return packed;
+    }
+
+    //  Convert `vertices` (`floatStride` floats per vertex) into `format`.
+    //  Components the float vertex does not have are filled with 1 (position w, color alpha)
+    inline std::vector<unsigned char> vertices(const std::vector<float>& vertices, int floatStride, const VertexFormat& format) {
+
+        size_t count = vertices.size() / floatStride;
+        std::vector<unsigned char> out(count * format.stride, 0);
+
+        for (size_t v = 0; v < count; v++) {
+
+            const float* source = &vertices[v * floatStride];
+            unsigned char* vertex = &out[v * format.stride];
+
+            for (size_t a = 0; a < format.attributes.size(); a++) {
+
+                const VertexAttribute& attribute = format.attributes[a];
+                unsigned char* target = vertex + attribute.offset;
+
+                float values[4];
+                for (int c = 0; c < 4; c++) {
+                    int from = attribute.sourceOffset + c;
+                    values[c] = (c < 3 && from < floatStride) ? source[from] : 1.0f;
+                }
+
+                //  the fourth component of a packed normal is unused, keep it 0
+                if (attribute.type == GL_INT_2_10_10_10_REV) {
+                    uint32_t packed = packSnorm2_10_10_10(values, 3);
+                    std::memcpy(target, &packed, 4);
+                    continue;
+                }
+
+                for (int c = 0; c < attribute.components; c++) {
+
+                    float value = values[c];
+
+                    switch (attribute.type) {
+                        case GL_FLOAT: std::memcpy(target + 4 * c, &value, 4); break;
+                        case GL_HALF_FLOAT: {
+                            uint16_t half = floatToHalf(value);
+                            std::memcpy(target + 2 * c, &half, 2);
+                            break;
+                        }
+                        case GL_UNSIGNED_BYTE: target[c] = (unsigned char)(attribute.normalized ? toUnsigned(value, 8) : (uint32_t)value); break;
+                        case GL_BYTE: target[c] = (unsigned char)(attribute.normalized ? toSigned(value, 8) : (int32_t)value); break;
+                        case GL_UNSIGNED_SHORT: {
+                            uint16_t s = (uint16_t)(attribute.normalized ? toUnsigned(value, 16) : (uint32_t)value);
+                            std::memcpy(target + 2 * c, &s, 2);
+                            break;
+                        }
+                        case GL_SHORT: {
+                            int16_t s = (int16_t)(attribute.normalized ? toSigned(value, 16) : (int32_t)value);
+                            std::memcpy(target + 2 * c, &s, 2);
+                            break;
+                        }
+                        default: throw std::runtime_error("Quantize: unsupported attribute type");
+                    }
+                }
+            }
+        }
+
+        return out;
+    }
+
+}
+
+#endif
@@ -0,0 +1,142 @@
+#ifndef VERTEX_LAYOUT_H
+#define VERTEX_LAYOUT_H
+
+#include "glad/glad.h"
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+//  Compile-time description of a vertex. Stride, offsets and GL types are all
+//  constant expressions, so `VertexLayout<...>::apply()` expands into the same
+//  glVertexAttribPointer calls one would write by hand, without the magic numbers:
+//
+//      using PositionColor = VertexLayout<
+//          Attribute<0, float, 3>,             //  location 0, vec3 position
+//          Attribute<1, float, 3>>;            //  location 1, vec3 color
+//
+//      static_assert(PositionColor::stride == 24, "");
+//      PositionColor::apply();
+
+//  Storage types without a C++ equivalent
+struct Half { uint16_t bits; };
+struct Packed2_10_10_10 { uint32_t bits; };
+
+//  C++ storage type -> GL component type
+template <typename T> struct GLType;
+template <> struct GLType<float> { static constexpr GLenum value = GL_FLOAT; };
+template <> struct GLType<Half> { static constexpr GLenum value = GL_HALF_FLOAT; };
+template <> struct GLType<int8_t> { static constexpr GLenum value = GL_BYTE; };
+template <> struct GLType<uint8_t> { static constexpr GLenum value = GL_UNSIGNED_BYTE; };
+template <> struct GLType<int16_t> { static constexpr GLenum value = GL_SHORT; };
+template <> struct GLType<uint16_t> { static constexpr GLenum value = GL_UNSIGNED_SHORT; };
+template <> struct GLType<int32_t> { static constexpr GLenum value = GL_INT; };
+template <> struct GLType<uint32_t> { static constexpr GLenum value = GL_UNSIGNED_INT; };
+template <> struct GLType<Packed2_10_10_10> { static constexpr GLenum value = GL_INT_2_10_10_10_REV; };
+
+//  One attribute: shader location, component type, component count and whether
+//  integers are normalized to [0, 1] / [-1, 1]
+template <unsigned int Index, typename T, int Components, bool Normalized = false>
+struct Attribute {
+
+    static_assert(Components >= 1 && Components <= 4, "Attribute: 1 to 4 components");
+    static_assert(!std::is_same<T, Packed2_10_10_10>::value || Components == 4,
+        "Attribute: 2_10_10_10 attributes have 4 components");
+
+    static constexpr unsigned int index = Index;
+    static constexpr int components = Components;
+    static constexpr GLenum type = GLType<T>::value;
+    static constexpr bool normalized = Normalized;
+
+    //  non-normalized integers feed ivec / uvec inputs through glVertexAttribIPointer
+    static constexpr bool integer = std::is_integral<T>::value && !Normalized;
+
+    //  packed types hold every component in one value
+    static constexpr unsigned int size =
+        std::is_same<T, Packed2_10_10_10>::value ? sizeof(T) : sizeof(T) * Components;
+
+    //  kept 4 byte aligned like VertexFormat::add
+    static constexpr unsigned int alignedSize = (size + 3) & ~3u;
+};
+
+template <typename... Attributes>
+class VertexLayout {
+
+public:
+
+    static constexpr size_t count = sizeof...(Attributes);
+    static constexpr unsigned int stride = (0u + ... + Attributes::alignedSize);
+
+    //  Byte offset of attribute `I`: the aligned sizes of the attributes before it
+    template <size_t I>
+    static constexpr unsigned int offset() {
+        constexpr unsigned int sizes[] = {Attributes::alignedSize..., 0u};
+        unsigned int total = 0;
+        for (size_t i = 0; i < I; i++) total += sizes[i];
+        return total;
+    }
+
+    //  Point every attribute at the VBO currently bound to GL_ARRAY_BUFFER
+    static void apply() {
+        static_assert(uniqueIndices(), "VertexLayout: two attributes share a location");
+        applyAll(std::make_index_sequence<count>());
+    }
+
+    //  Call `visit(Attribute{})` for every attribute in order, so runtime code
+    //  (e.g. VertexFormat::fromLayout) can be derived from the same list
+    template <typename Visit>
+    static void forEach(Visit visit) {
+        (visit(Attributes()), ...);
+    }
+
+private:
+
+    static_assert(sizeof...(Attributes) > 0, "VertexLayout: needs at least one attribute");
+
+    static constexpr bool uniqueIndices() {
+        constexpr unsigned int indices[] = {Attributes::index...};
+        for (size_t i = 0; i < count; i++)
+            for (size_t j = i + 1; j < count; j++)
+                if (indices[i] == indices[j]) return false;
+        return true;
+    }
+
+    template <size_t... I>
+    static void applyAll(std::index_sequence<I...>) {
+        (applyOne<Attributes, offset<I>()>(), ...);
+    }
+
+    template <typename A, unsigned int Offset>
+    static void applyOne() {
+        if constexpr (A::integer) {
+            glVertexAttribIPointer(A::index, A::components, A::type, stride, (void*)(uintptr_t)Offset);
+        } else {
+            glVertexAttribPointer(A::index, A::components, A::type,
+                A::normalized ? GL_TRUE : GL_FALSE, stride, (void*)(uintptr_t)Offset);
+        }
+        glEnableVertexAttribArray(A::index);
+    }
+
+};
+
+//  The layouts the pipeline uses, VertexFormat::floatPositionColor,
+//  compactPositionColor and compactPositionColorNormal are built from them
+using PositionColorLayout = VertexLayout<
+    Attribute<0, float, 3>,
+    Attribute<1, float, 3>>;
+
+using CompactPositionColorLayout = VertexLayout<
+    Attribute<0, Half, 4>,
+    Attribute<1, uint8_t, 4, true>>;
+
+using CompactPositionColorNormalLayout = VertexLayout<
+    Attribute<0, Half, 4>,
+    Attribute<1, uint8_t, 4, true>,
+    Attribute<2, Packed2_10_10_10, 4, true>>;
+
+static_assert(PositionColorLayout::stride == 6 * sizeof(float), "PositionColorLayout: 24 byte vertices");
+static_assert(PositionColorLayout::offset<1>() == 3 * sizeof(float), "PositionColorLayout: color after position");
+static_assert(CompactPositionColorLayout::stride == 12, "CompactPositionColorLayout: 12 byte vertices");
+static_assert(CompactPositionColorNormalLayout::stride == 16, "CompactPositionColorNormalLayout: 16 byte vertices");
+
+#endif
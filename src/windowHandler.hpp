@@ -1,5 +1,17 @@
 #include "pipeline.hpp"
 #include "shader.hpp"
+#include "headless.hpp"
+#include "glState.hpp"
+#include "gpuProfiler.hpp"
+#include "cpuProfiler.hpp"
+#include "shaderWatcher.hpp"
+#include "framePacer.hpp"
+#include "inputEvents.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <thread>
 
 
 class WindowHandler {
@@ -8,13 +20,45 @@ class WindowHandler {
 public:
 
     Shader& shader;
+    const AppOptions& options;
 
-    WindowHandler(Shader& _shader) : shader(_shader) {}
+    WindowHandler(Shader& _shader, const AppOptions& _options)
+        : shader(_shader), options(_options), headless(_options.backend, _options.width, _options.height) {}
+
+    GLFWwindow* window = NULL;
+
+    //  context used instead of the GLFW window by the headless backends
+    HeadlessContext headless;
+
+    //  frames rendered so far by renderLoop
+    unsigned int frameCount = 0;
+
+    //  GPU time of the passes of renderLoop, enabled by `--gpu-profile`
+    GPUProfiler gpuProfiler;
+
+    //  swaps in edited shaders between frames, started by `--watch-shaders`
+    ShaderReloader shaderReloader;
+
+    //  frame-rate cap, late frame detection and the frame time histogram
+    FramePacer framePacer;
+
+    //  holds the Frame block, uploaded once per frame for every program
+    UniformBuffer uniformBuffer;
+    size_t frameBlock = 0;
+
+    bool isHeadless() const {
+        return options.backend != Backend::Window;
+    }
 
-    GLFWwindow* window;
-    
     void createWindow() {
 
+        startTime = std::chrono::steady_clock::now();
+
+        if (isHeadless()) {
+            headless.create();
+            return;
+        }
+
         glfwInit();
 
         //   first argument tells what option to configure from a large enum of options
@@ -23,65 +67,526 @@ public:
         glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
         glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
         glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-        
-        window = glfwCreateWindow(700, 700, "Learn OpenGL", NULL, NULL);
+
+        window = glfwCreateWindow(options.width, options.height, "Learn OpenGL", NULL, NULL);
 
         if (window == NULL) {
-            throw std::runtime_error("Failed To Create GLFW Window");
             glfwTerminate();
+            throw std::runtime_error("Failed To Create GLFW Window");
         }
 
         glfwMakeContextCurrent(window);
 
+        //  0 presents immediately, 1 waits for every vblank, N for every Nth
+        if (options.swapInterval >= 0) {
+            glfwSwapInterval(options.swapInterval);
+        }
+
         //  Register the callback for window resize
         glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-        
+
+        //  anything that can change the picture marks the frame dirty for `--on-demand`
+        glfwSetWindowUserPointer(window, this);
+        glfwSetKeyCallback(window, key_callback);
+        glfwSetMouseButtonCallback(window, mouse_button_callback);
+        glfwSetCursorPosCallback(window, cursor_pos_callback);
+        glfwSetScrollCallback(window, scroll_callback);
+        glfwSetWindowRefreshCallback(window, window_refresh_callback);
+
+        //  a reloaded shader has to wake a loop blocked in glfwWaitEventsTimeout
+        shaderReloader.watcher.onChange = []() { glfwPostEmptyEvent(); };
+
     }
 
-    //  Tell openGL the size of the rendering window so 
+    //  Function pointer loader for glad, taken from whichever API owns the context
+    GLADloadproc procLoader() {
+
+        if (isHeadless()) {
+            return headless.procLoader();
+        }
+
+        return (GLADloadproc)glfwGetProcAddress;
+    }
+
+    //  Headless contexts have no default framebuffer, so create the FBO the
+    //  frames are rendered into. Needs glad to be loaded
+    void createRenderTarget() {
+
+        if (isHeadless()) {
+            headless.createFramebuffer();
+        }
+
+        if (options.gpuProfile) {
+            gpuProfiler.enable();
+        }
+
+        uniformBuffer.create(4096);
+        frameBlock = uniformBuffer.allocate(FrameLayout::size);
+
+    }
+
+    //  Seconds since the window (or headless context) was created
+    double getTime() {
+
+        if (isHeadless()) {
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+            return elapsed.count();
+        }
+
+        return glfwGetTime();
+    }
+
+    //  Tell openGL the size of the rendering window so
     //  openGL knows how the data and coordinates will be displayed
-    //  with respect to the window. This gets call every time the window is 
+    //  with respect to the window. This gets call every time the window is
     //  resized
     static void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
-        glViewport(0, 0, width, height);
+
+        InputEvent event;
+        event.type = InputEvent::Resize;
+        event.code = width;
+        event.action = height;
+        dispatch(window, event);
+    }
+
+    static void key_callback(GLFWwindow* window, int key, int /*scancode*/, int action, int mods) {
+
+        InputEvent event;
+        event.type = InputEvent::Key;
+        event.code = key;
+        event.action = action;
+        event.mods = mods;
+        dispatch(window, event);
+    }
+
+    static void mouse_button_callback(GLFWwindow* window, int button, int action, int mods) {
+
+        InputEvent event;
+        event.type = InputEvent::MouseButton;
+        event.code = button;
+        event.action = action;
+        event.mods = mods;
+        dispatch(window, event);
+    }
+
+    static void cursor_pos_callback(GLFWwindow* window, double x, double y) {
+
+        InputEvent event;
+        event.type = InputEvent::CursorPos;
+        event.x = x;
+        event.y = y;
+        dispatch(window, event);
+    }
+
+    static void scroll_callback(GLFWwindow* window, double x, double y) {
+
+        InputEvent event;
+        event.type = InputEvent::Scroll;
+        event.x = x;
+        event.y = y;
+        dispatch(window, event);
+    }
+
+    //  the window system lost the contents, e.g. after being uncovered
+    static void window_refresh_callback(GLFWwindow* window) {
+
+        InputEvent event;
+        event.type = InputEvent::Refresh;
+        dispatch(window, event);
+    }
+
+    //  Apply an event on the thread that owns the context: the viewport follows
+    //  the framebuffer, and anything that can change the picture marks the frame dirty
+    void applyInput(const InputEvent& event) {
+
+        switch (event.type) {
+        case InputEvent::Resize:
+            glViewport(0, 0, event.code, event.action);
+            dirty |= DirtyResize;
+            break;
+        case InputEvent::Refresh:
+            dirty |= DirtyExpose;
+            break;
+        default:
+            dirty |= DirtyInput;
+            break;
+        }
     }
 
     //  Keep the application running until user stops the application
-    void renderLoop(GraphicsPipeline pipeline) {
+    void renderLoop(GraphicsPipeline& pipeline) {
+
+        framePacer.targetFps = options.fpsCap;
+        framePacer.start();
+
+        if (options.renderThread) {
+            runRenderThread(pipeline);
+            return;
+        }
 
         //  checks start of each loop if GLFW has been instructed to close
-        while (!glfwWindowShouldClose(window)) {
+        while (!shouldClose()) {
+
+            CPU_ZONE("frame");
+
+            {
+                CPU_ZONE("processInput");
+
+                //terminate window upon escape key
+                processInput();
+            }
+
+            renderFrame(pipeline);
+
+            if (renderOnDemand()) {
+                CPU_ZONE("wait");
+
+                //  sleeps until the next frame would look different
+                waitForWork();
+                framePacer.resync();
+            } else {
+                CPU_ZONE("poll");
+
+                //  checks if any events are triggered
+                pollEvents();
+            }
+
+            GLStateCache::endFrame();
+            GLResources::endFrame();
+            frameCount++;
+        }
+    }
 
+    //  `--render-thread`: the context moves to a thread that does nothing but
+    //  render, while this (the main) thread blocks in glfwWaitEvents and hands
+    //  input over through `input`. A slow frame no longer delays event handling,
+    //  and waiting for events no longer eats into the frame. GLFW requires its
+    //  event functions on the main thread, so it is the GL work that moves
+    void runRenderThread(GraphicsPipeline& pipeline) {
 
-            //terminate window upon escape key
+        closing = false;
+        renderDone = false;
+        threaded = true;
+
+        releaseContext();
+
+        std::exception_ptr failure;
+        std::thread renderer([&]() {
+
+            try {
+                makeContextCurrent();
+
+                while (!shouldClose()) {
+
+                    CPU_ZONE("frame");
+
+                    {
+                        CPU_ZONE("drainInput");
+                        drainInput();
+                    }
+
+                    renderFrame(pipeline);
+
+                    GLStateCache::endFrame();
+                    GLResources::endFrame();
+                    frameCount++;
+                }
+            } catch (...) {
+                failure = std::current_exception();
+            }
+
+            releaseContext();
+            renderDone.store(true, std::memory_order_release);
+
+            //  wake the event loop so it sees the render thread is gone
+            if (!isHeadless()) glfwPostEmptyEvent();
+        });
+
+        //  headless runs have no events to wait for
+        while (!isHeadless() && !renderDone.load(std::memory_order_acquire)) {
+
+            CPU_ZONE("events");
+
+            glfwWaitEvents();
             processInput();
 
+            if (glfwWindowShouldClose(window)) {
+                closing.store(true, std::memory_order_release);
+            }
+        }
+
+        renderer.join();
+        threaded = false;
+
+        //  the caller reads back the frame and cleans up from this thread
+        makeContextCurrent();
+
+        if (failure) std::rethrow_exception(failure);
+    }
+
+    //  One frame, from picking up a reloaded shader to the frame pacer
+    void renderFrame(GraphicsPipeline& pipeline) {
+
+        {
+            CPU_ZONE("shaderReload");
+
+            //  frame boundary: nothing is using the program right now
+            shaderReloader.update(shader);
+        }
+
+        gpuProfiler.beginFrame();
+        gpuProfiler.pushScope("frame");
+
+        {
+            CPU_ZONE("clear");
+            GPUScope scope(gpuProfiler, "clear");
             glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
             glClear(GL_COLOR_BUFFER_BIT);
+        }
+
+        {
+            CPU_ZONE("draw");
+            GPUScope scope(gpuProfiler, "draw");
 
             //  draw triangle
-            shader.useProgram();              //  activate shader program
-            shader.changeColorUsingUniform(); //  update color in fragment shader using uniform
+            shader.useProgram();              //  activate shader program (finishes an async build)
+            updateFrameUniforms(getTime());   //  color and time for the Frame block, if the program has one
             pipeline.bindVAO();                 //  Bind the VAO before drawing the triangle
-            pipeline.drawTriangle(3);          //  draw triangle
+            pipeline.draw();                   //  draw triangle
             // glBindVertexArray(0);
+        }
+
+        {
+            CPU_ZONE("swap");
+            GPUScope scope(gpuProfiler, "swap");
 
             //  swap the color bufer
-            glfwSwapBuffers(window);
+            swapBuffers();
+        }
 
-            //  checks if any events are triggered
-            glfwPollEvents();
+        {
+            CPU_ZONE("pace");
+
+            //  waits for the next deadline when the frame rate is capped
+            framePacer.endFrame();
         }
+
+        gpuProfiler.popScope();
+        gpuProfiler.endFrame();
+    }
+
+    //  Why the next frame has to be drawn
+    enum DirtyReason {
+        DirtyInput = 1,
+        DirtyResize = 2,
+        DirtyExpose = 4,
+        DirtyAnimation = 8,
+        DirtyShader = 16
+    };
+
+    //  `--on-demand` only draws when something changed, otherwise the loop sleeps
+    //  in glfwWaitEventsTimeout. Headless runs have no events and always draw, and
+    //  with `--render-thread` the waiting happens on the event thread instead
+    bool renderOnDemand() const {
+        return options.renderOnDemand && !isHeadless() && !options.renderThread;
+    }
+
+    //  Redraw rate of programs that animate (see Shader::isAnimated)
+    static constexpr double animationFps = 60.0;
+
+    //  Fill the Frame block and send it in one upload, whatever the number of programs.
+    //  Skipped while the program does not declare the block, nothing would read it
+    void updateFrameUniforms(double time) {
+
+        if (!shader.usesFrameBlock) return;
+
+        Std140Block<FrameLayout> frame;
+        frame.set<FrameColor>(Shader::animatedColor((float)time));
+        frame.set<FrameTime>((float)time);
+
+        uniformBuffer.write(frameBlock, frame.data, sizeof(frame.data));
+        uniformBuffer.upload();
+        uniformBuffer.bindRange(FrameBinding, frameBlock, sizeof(frame.data));
     }
 
     //  terminate window if pressed key is escape key
     void processInput() {
 
+        if (isHeadless()) {
+            return;
+        }
+
         if(glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
             glfwSetWindowShouldClose(window, true);
         }
 
     }
 
-    
-};
\ No newline at end of file
+    //  Write the last rendered frame to `path`. Only headless targets can be read back
+    void saveFrame(const std::string& path) {
+
+        if (!isHeadless()) {
+            throw std::runtime_error("Saving Frames Needs A Headless Backend");
+        }
+
+        headless.saveFrame(path);
+    }
+
+    void destroy() {
+
+        //  queries have to be read back while the context is alive
+        gpuProfiler.report();
+        framePacer.report();
+
+        if (!options.frameHistogramPath.empty()) {
+            framePacer.writeHistogram(options.frameHistogramPath);
+        }
+
+        shaderReloader.stop();
+        input.report();
+
+        if (renderOnDemand()) {
+            double seconds = getTime();
+            std::printf("render on demand: %u frames in %.1f s (%.1f fps), %lu wakeups\n",
+                frameCount, seconds, seconds > 0.0 ? frameCount / seconds : 0.0, wakeups);
+        }
+
+        uniformBuffer.destroy();
+
+        //  last chance to delete GL objects, the context goes next
+        GLResources::shutdown();
+
+        if (isHeadless()) {
+            headless.destroy();
+        } else {
+            glfwTerminate();
+        }
+
+    }
+
+private:
+
+    std::chrono::steady_clock::time_point startTime;
+
+    //  DirtyReason bits collected since the last frame
+    unsigned int dirty = 0;
+
+    //  events from the GLFW callbacks to the render thread, while `threaded`
+    InputChannel input;
+    std::atomic<bool> threaded{false};
+    std::atomic<bool> closing{false};       //  the window was asked to close
+    std::atomic<bool> renderDone{false};    //  the render thread left its loop
+
+    //  times waitForWork returned from glfwWaitEventsTimeout
+    unsigned long wakeups = 0;
+
+    //  Callbacks run on the main thread inside glfwPollEvents / glfwWaitEvents.
+    //  The event is applied right away, or queued when the context lives on the render thread
+    static void dispatch(GLFWwindow* window, const InputEvent& event) {
+
+        WindowHandler* handler = (WindowHandler*)glfwGetWindowUserPointer(window);
+        if (handler == NULL) return;
+
+        if (handler->threaded.load(std::memory_order_acquire)) {
+            handler->input.push(event);
+        } else {
+            handler->applyInput(event);
+        }
+    }
+
+    //  Render thread: apply everything the event thread queued since the last frame
+    void drainInput() {
+
+        InputEvent event;
+
+        while (input.pop(event)) {
+            applyInput(event);
+        }
+    }
+
+    //  Block until input, a resize, the animation clock or a reloaded shader
+    //  asks for a new frame. A static scene wakes up once a second at most
+    void waitForWork() {
+
+        dirty = 0;
+        double nextAnimation = getTime() + 1.0 / animationFps;
+
+        while (dirty == 0 && !shouldClose()) {
+
+            double timeout = 1.0;
+
+            if (shader.isAnimated()) {
+                timeout = std::max(0.0, nextAnimation - getTime());
+            }
+
+            //  a build in flight is polled, there is no event for it finishing
+            if (shaderReloader.busy()) {
+                timeout = std::min(timeout, 0.01);
+            }
+
+            glfwWaitEventsTimeout(timeout);
+            wakeups++;
+
+            if (shader.isAnimated() && getTime() >= nextAnimation) {
+                dirty |= DirtyAnimation;
+            }
+
+            //  no frame is in progress, so this is a frame boundary too
+            if (shaderReloader.update(shader)) {
+                dirty |= DirtyShader;
+            }
+        }
+    }
+
+    bool shouldClose() {
+
+        if (options.frames != 0 && frameCount >= options.frames) {
+            return true;
+        }
+
+        //  glfwWindowShouldClose is not synchronized, the render thread reads the flag the event thread sets
+        if (threaded.load(std::memory_order_acquire)) {
+            return closing.load(std::memory_order_acquire);
+        }
+
+        return !isHeadless() && glfwWindowShouldClose(window);
+    }
+
+    void makeContextCurrent() {
+
+        if (isHeadless()) {
+            headless.makeCurrent();
+        } else {
+            glfwMakeContextCurrent(window);
+        }
+    }
+
+    void releaseContext() {
+
+        if (isHeadless()) {
+            headless.release();
+        } else {
+            glfwMakeContextCurrent(NULL);
+        }
+    }
+
+    void swapBuffers() {
+
+        if (isHeadless()) {
+            headless.finishFrame();
+        } else {
+            glfwSwapBuffers(window);
+        }
+
+    }
+
+    void pollEvents() {
+
+        if (!isHeadless()) {
+            glfwPollEvents();
+        }
+
+    }
+
+
+};